@@ -0,0 +1,1319 @@
+////////////////////////////////////////////////////////////////////////////////
+// Monte Carlo pricing of European call options across multiple emulated
+// devices. Each device is a group of host cores; the option batch is sliced
+// into one TOptionPlan per device and the plans are priced concurrently, with
+// idle devices stealing path chunks from their neighbours.
+////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "MonteCarlo_basket.h"
+#include "MonteCarlo_common.h"
+#include "MonteCarlo_localvol.h"
+#include "MonteCarlo_mlmc.h"
+#include "MonteCarlo_normal.h"
+#include "MonteCarlo_reduction.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Command line helpers: flags take the form --name or --name=value
+////////////////////////////////////////////////////////////////////////////////
+static const char *getCmdLineArgument(int argc, char **argv, const char *name) {
+  size_t len = strlen(name);
+
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    while (*arg == '-') arg++;
+    if (strncmp(arg, name, len) != 0) continue;
+    if (arg[len] == '=') return arg + len + 1;
+    if (arg[len] == '\0') return "";
+  }
+
+  return NULL;
+}
+
+static bool checkCmdLineFlag(int argc, char **argv, const char *name) {
+  return getCmdLineArgument(argc, argv, name) != NULL;
+}
+
+static int getCmdLineArgumentInt(int argc, char **argv, const char *name,
+                                 int defaultValue) {
+  const char *value = getCmdLineArgument(argc, argv, name);
+  return (value && *value) ? atoi(value) : defaultValue;
+}
+
+static double getCmdLineArgumentFloat(int argc, char **argv, const char *name,
+                                      double defaultValue) {
+  const char *value = getCmdLineArgument(argc, argv, name);
+  return (value && *value) ? atof(value) : defaultValue;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Helper function, returning uniformly distributed
+// random float in [low, high] range
+////////////////////////////////////////////////////////////////////////////////
+static real randFloat(std::mt19937 &gen, real low, real high) {
+  real t = (real)gen() / (real)gen.max();
+  return ((real)1.0 - t) * low + t * high;
+}
+
+// Payoffs selectable with --payoff and the reference each is checked against.
+// Approximate references are held to a relative L1 error bound instead of
+// the confidence width.
+typedef struct {
+  const char *flag;
+  TPayoffType type;
+  const char *name;
+  const char *reference;
+  bool exactReference;
+} TPayoffInfo;
+
+static const TPayoffInfo payoffInfo[] = {
+    {"call", PAYOFF_CALL, "European call", "Black-Scholes", true},
+    {"lookback", PAYOFF_LOOKBACK_CALL, "fixed-strike lookback call",
+     "discretely monitored lookback", false},
+    {"asian", PAYOFF_ASIAN_CALL, "arithmetic Asian call", "Levy Asian", false},
+    {"geometric-asian", PAYOFF_GEOMETRIC_ASIAN_CALL, "geometric Asian call",
+     "closed-form geometric Asian", true},
+    {"down-out", PAYOFF_DOWN_OUT_CALL, "down-and-out call",
+     "closed-form barrier", true},
+    {"down-in", PAYOFF_DOWN_IN_CALL, "down-and-in call", "closed-form barrier",
+     true},
+    {"up-out", PAYOFF_UP_OUT_CALL, "up-and-out call", "closed-form barrier",
+     true},
+    {"up-in", PAYOFF_UP_IN_CALL, "up-and-in call", "closed-form barrier", true},
+    {"american-put", PAYOFF_AMERICAN_PUT, "American put",
+     "binomial Bermudan put", true},
+    {"basket", PAYOFF_BASKET_CALL, "basket call", "Levy basket", false},
+    {"digital", PAYOFF_DIGITAL_CALL, "digital call", "closed-form digital",
+     true},
+};
+
+// Names of the precision policies selectable with --precision
+static const char *precisionNames[PRECISION_N] = {"float", "compensated",
+                                                   "mixed", "double"};
+
+// Names of the models selectable with --model
+static const char *modelNames[] = {"gbm", "heston", "local-vol", "merton"};
+
+// Options per local volatility surface; they share its spot
+static const int LOCALVOL_GROUP_N = 16;
+
+static bool isBarrier(TPayoffType type) {
+  return type >= PAYOFF_DOWN_OUT_CALL && type <= PAYOFF_UP_IN_CALL;
+}
+
+static bool isUpBarrier(TPayoffType type) {
+  return type == PAYOFF_UP_OUT_CALL || type == PAYOFF_UP_IN_CALL;
+}
+
+static const TPayoffInfo *getPayoffInfo(const char *flag) {
+  for (const TPayoffInfo &info : payoffInfo)
+    if (!flag || strcmp(flag, info.flag) == 0) return &info;
+  return NULL;
+}
+
+static double referencePrice(TPayoffType type, const TOptionData &option,
+                             int stepN, double barrier,
+                             const TBasket *basket) {
+  if (isBarrier(type))
+    return BarrierCall(option, barrier, isUpBarrier(type),
+                       type == PAYOFF_DOWN_IN_CALL ||
+                           type == PAYOFF_UP_IN_CALL);
+
+  switch (type) {
+    case PAYOFF_LOOKBACK_CALL:
+      return LookbackCall(option, stepN);
+    case PAYOFF_ASIAN_CALL:
+      return AsianCallLevy(option, stepN);
+    case PAYOFF_GEOMETRIC_ASIAN_CALL:
+      return GeometricAsianCall(option, stepN);
+    case PAYOFF_AMERICAN_PUT:
+      return BermudanPutBinomial(option, stepN);
+    case PAYOFF_BASKET_CALL:
+      return BasketCallLevy(*basket, option);
+    case PAYOFF_DIGITAL_CALL:
+      return DigitalCall(option);
+    default:
+      return BlackScholesCall(option);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reference Greeks by central differences of the reference price; the barrier
+// level stays fixed when the spot moves
+////////////////////////////////////////////////////////////////////////////////
+static void referenceGreeks(double *greeks, TPayoffType type,
+                            const TOptionData &option, int stepN,
+                            double barrier) {
+  for (int k = 0; k < GREEK_N; k++) {
+    TOptionData up = option, down = option;
+    real &upValue = k == GREEK_DELTA ? up.S : k == GREEK_VEGA ? up.V : up.R;
+    real &downValue =
+        k == GREEK_DELTA ? down.S : k == GREEK_VEGA ? down.V : down.R;
+    const real h = k == GREEK_DELTA ? (real)1e-3 * option.S : (real)1e-3;
+
+    upValue += h;
+    downValue -= h;
+    greeks[k] = (referencePrice(type, up, stepN, barrier, NULL) -
+                 referencePrice(type, down, stepN, barrier, NULL)) /
+                ((double)upValue - (double)downValue);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Basket inputs in the gradient layout of basketGradientN(): entry j is a
+// spot, a volatility, or a correlation whose two triangles move together.
+// Writes pointers to the entries to bump and returns their count.
+////////////////////////////////////////////////////////////////////////////////
+static int basketInput(TBasket &basket, int j, real **input) {
+  const int n = basket.assetN;
+
+  if (j < n) {
+    input[0] = &basket.S[j];
+    return 1;
+  }
+  if (j < 2 * n) {
+    input[0] = &basket.V[j - n];
+    return 1;
+  }
+
+  // Correlation (a, b), b < a, at a (a - 1) / 2 + b
+  int a = 1, b = j - 2 * n;
+  while (b >= a) b -= a++;
+  input[0] = &basket.Correlation[a * n + b];
+  input[1] = &basket.Correlation[b * n + a];
+  return 2;
+}
+
+// Central difference step of basket input j. Volatilities and correlations
+// take 1e-2 so that single-precision rounding of the repriced batch does not
+// swamp the difference.
+static real basketBump(const TBasket &basket, int j) {
+  return j < basket.assetN ? (real)1e-3 * basket.S[j] : (real)1e-2;
+}
+
+// Set basket input j to value, returning the value actually stored
+static real setBasketInput(TBasket &basket, int j, real value) {
+  real *input[2];
+  const int inputN = basketInput(basket, j, input);
+  for (int k = 0; k < inputN; k++) *input[k] = value;
+  return *input[0];
+}
+
+// Reference basket gradient by central differences of Levy's price
+static void referenceBasketGradient(double *gradient, TBasket &basket,
+                                    const TOptionData &option) {
+  real *input[2];
+
+  for (int j = 0; j < basketGradientN(basket.assetN); j++) {
+    basketInput(basket, j, input);
+    const real value = *input[0];
+    const real h = basketBump(basket, j);
+
+    const double up = setBasketInput(basket, j, value + h);
+    const double priceUp = BasketCallLevy(basket, option);
+    const double down = setBasketInput(basket, j, value - h);
+    const double priceDown = BasketCallLevy(basket, option);
+    setBasketInput(basket, j, value);
+    gradient[j] = (priceUp - priceDown) / (up - down);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// FNV-1a hash of the result bits, for comparing runs bit for bit. Greeks and
+// basket gradients are hashed only when computed, so price-only checksums
+// match across versions.
+////////////////////////////////////////////////////////////////////////////////
+static void hashBytes(uint64_t &hash, const void *data, size_t n) {
+  const unsigned char *bytes = (const unsigned char *)data;
+
+  for (size_t i = 0; i < n; i++) {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ull;
+  }
+}
+
+static uint64_t resultChecksum(const TOptionValue *callValue, int optionN,
+                               bool greeks, const std::vector<real> &gradient) {
+  uint64_t hash = 0xcbf29ce484222325ull;
+
+  for (int i = 0; i < optionN; i++) {
+    hashBytes(hash, &callValue[i].Expected, sizeof(real));
+    hashBytes(hash, &callValue[i].Confidence, sizeof(real));
+    if (greeks) {
+      hashBytes(hash, callValue[i].Greek, sizeof(callValue[i].Greek));
+      hashBytes(hash, callValue[i].GreekConfidence,
+                sizeof(callValue[i].GreekConfidence));
+    }
+  }
+  hashBytes(hash, gradient.data(), gradient.size() * sizeof(real));
+
+  return hash;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Price every plan concurrently, one host thread driving each device. Runs
+// rounds until no option needs more paths; returns the number of rounds.
+////////////////////////////////////////////////////////////////////////////////
+static int multiSolver(TOptionPlan *plan, int nPlans) {
+  int roundN = 0;
+
+  for (int i = 0; i < nPlans; i++) initMonteCarloDevice(&plan[i]);
+
+  do {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < nPlans; i++)
+      threads.emplace_back(MonteCarloDevice, &plan[i]);
+    for (auto &t : threads) t.join();
+
+    for (int i = 0; i < nPlans; i++) reduceMonteCarloDevice(&plan[i]);
+    roundN++;
+  } while (scheduleMonteCarloRound(plan[0].batch, nPlans) > 0);
+
+  return roundN;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Price the batch once with the plans in `plan`, which must point at `batch`
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  int roundN;
+  double time;
+  long long pathsDone;
+  int convergedN;
+  // Median over options of the variance reduction against plain sampling,
+  // leaving out the unresolvedN options whose residual variance is zero or
+  // unresolved (h_VarianceRatio 0)
+  double varianceRatio;
+  int unresolvedN;
+  // Most levels used by an option in multilevel runs
+  int levelN;
+} TRunStats;
+
+static TRunStats runBatch(TBatchPlan *batch, TOptionPlan *plan, int nPlans,
+                          bool steal) {
+  TRunStats stats = {};
+
+  initMonteCarloBatch(batch, nPlans, steal);
+
+  auto start = std::chrono::steady_clock::now();
+  stats.roundN = multiSolver(plan, nPlans);
+  stats.time = std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+
+  std::vector<real> ratio;
+  for (int i = 0; i < batch->optionN; i++) {
+    stats.pathsDone += batch->h_PathN[i];
+    stats.convergedN +=
+        batch->levelN > 0
+            ? mlmcConverged(batch, i)
+            : batch->callValue[i].Confidence < batch->options->Tolerance[i];
+    if (batch->levelN > 0)
+      stats.levelN = std::max(stats.levelN, batch->h_LevelN[i]);
+    if (batch->h_VarianceRatio[i] > 0)
+      ratio.push_back(batch->h_VarianceRatio[i]);
+  }
+  stats.unresolvedN = batch->optionN - (int)ratio.size();
+  if (!ratio.empty()) {
+    std::nth_element(ratio.begin(), ratio.begin() + ratio.size() / 2,
+                     ratio.end());
+    stats.varianceRatio = ratio[ratio.size() / 2];
+  }
+
+  closeMonteCarloBatch(batch);
+  return stats;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Paths needed to reach a confidence tolerance with each estimator: adaptive
+// runs of the same batch with plain sampling, antithetic variates, the
+// control variate and both
+////////////////////////////////////////////////////////////////////////////////
+static void benchmarkVariance(TBatchPlan *batch, TOptionPlan *plan,
+                              int nPlans, bool steal, int roundN) {
+  const char *names[] = {"plain", "antithetic", "control", "antithetic+control"};
+  const long long budget = (long long)batch->optionN * batch->pathN;
+  long long plainPaths = 0;
+
+  printf("Variance reduction benchmark (tolerance %f):\n",
+         (double)batch->options->Tolerance[0]);
+  printf("  Variance reduction is the median over options, leaving out "
+         "unresolved ones: those\n  whose residual variance, summed over "
+         "all samples, is below one plain path's\n");
+
+  for (int k = 0; k < 4; k++) {
+    TBatchPlan run = *batch;
+    run.antithetic = (k & 1) != 0;
+    run.controlVariate = (k & 2) != 0;
+    run.roundChunkN = roundN;
+    for (int i = 0; i < nPlans; i++) plan[i].batch = &run;
+
+    TRunStats stats = runBatch(&run, plan, nPlans, steal);
+    if (k == 0) plainPaths = stats.pathsDone;
+
+    printf("  %-19s %10.3f ms, %12lld paths (%5.1f%% of budget), "
+           "%4i of %i converged, variance reduction %9.3fx "
+           "(%3i unresolved), path saving %7.2fx\n",
+           names[k], stats.time, stats.pathsDone,
+           100.0 * stats.pathsDone / budget, stats.convergedN, batch->optionN,
+           stats.varianceRatio, stats.unresolvedN,
+           (double)plainPaths / stats.pathsDone);
+  }
+
+  for (int i = 0; i < nPlans; i++) plan[i].batch = batch;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// One-step call batch under every precision policy. The policies price the
+// same samples, so their distance from the double policy is rounding error
+// alone; its mean is reported against the mean confidence width.
+//
+// The mixed policy sums the same float payoffs as the float policies in
+// double lanes, so its payoff sums and sums of squares are the double
+// precision reference for their accumulation. Compensated sums must match
+// them to within ACCUMULATION_BOUND; returns whether they do.
+////////////////////////////////////////////////////////////////////////////////
+static const double ACCUMULATION_BOUND = 1e-12;
+
+static bool benchmarkPrecision(TBatchPlan *batch, TOptionPlan *plan,
+                               int nPlans, bool steal,
+                               const TOptionData *optionData) {
+  const int optionN = batch->optionN;
+  std::vector<TOptionValue> value[PRECISION_N];
+  // Per-option payoff sum and sum of squares over all path blocks
+  std::vector<double> mean[PRECISION_N], m2[PRECISION_N];
+  double time[PRECISION_N];
+
+  printf("Precision benchmark (%i options x %i paths):\n", optionN,
+         batch->pathN);
+
+  for (int p = 0; p < PRECISION_N; p++) {
+    TBatchPlan run = *batch;
+    run.precision = (TPrecision)p;
+    for (int i = 0; i < nPlans; i++) plan[i].batch = &run;
+
+    initMonteCarloBatch(&run, nPlans, steal);
+    auto start = std::chrono::steady_clock::now();
+    multiSolver(plan, nPlans);
+    time[p] = std::chrono::duration<double, std::milli>(
+                  std::chrono::steady_clock::now() - start)
+                  .count();
+
+    value[p].assign(batch->callValue, batch->callValue + optionN);
+    for (int i = 0; i < optionN; i++) {
+      const int blockN = (run.h_PathN[i] + PATH_BLOCK_N - 1) / PATH_BLOCK_N;
+      const TBlockMoments moments =
+          treeSum(run.h_BlockMoments + i * run.blockN, blockN);
+      mean[p].push_back(moments.mean[MOMENT_PAYOFF]);
+      m2[p].push_back(moments.m2[MOMENT_PAYOFF]);
+    }
+    closeMonteCarloBatch(&run);
+  }
+
+  bool passed = true;
+
+  for (int p = 0; p < PRECISION_N; p++) {
+    double sumDelta = 0, sumRef = 0, sumRounding = 0, sumConfidence = 0;
+    double errorMean = 0, errorM2 = 0;
+
+    for (int i = 0; i < optionN; i++) {
+      const double ref = BlackScholesCall(optionData[i]);
+      const double rounding = fabs((double)value[p][i].Expected -
+                                   value[PRECISION_DOUBLE][i].Expected);
+      sumDelta += fabs(ref - value[p][i].Expected);
+      sumRef += fabs(ref);
+      sumRounding += rounding;
+      sumConfidence += value[PRECISION_DOUBLE][i].Confidence;
+
+      // Relative accumulation error against double lanes
+      const double mixed = mean[PRECISION_MIXED][i];
+      const double mixed2 = m2[PRECISION_MIXED][i];
+      if (mixed != 0)
+        errorMean =
+            std::max(errorMean, fabs(mean[p][i] - mixed) / fabs(mixed));
+      if (mixed2 != 0)
+        errorM2 = std::max(errorM2, fabs(m2[p][i] - mixed2) / fabs(mixed2));
+    }
+
+    printf("  %-11s %10.3f ms, %E paths/sec, %5.2fx double, "
+           "L1 norm %E, rounding %E (%.2e of confidence)\n",
+           precisionNames[p], time[p],
+           (double)optionN * batch->pathN / (time[p] * 0.001),
+           time[PRECISION_DOUBLE] / time[p], sumDelta / sumRef,
+           sumRounding / optionN,
+           sumConfidence > 0 ? sumRounding / sumConfidence : 0.0);
+    if (p == PRECISION_FLOAT || p == PRECISION_COMPENSATED)
+      printf("  %-11s moments vs. double lanes: mean %.2e, M2 %.2e\n", "",
+             errorMean, errorM2);
+    if (p == PRECISION_COMPENSATED)
+      passed = errorMean <= ACCUMULATION_BOUND &&
+               errorM2 <= ACCUMULATION_BOUND;
+  }
+
+  printf("Compensated moments within %.0e of double lanes: %s\n",
+         ACCUMULATION_BOUND, passed ? "yes" : "no");
+  for (int i = 0; i < nPlans; i++) plan[i].batch = batch;
+  return passed;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Basket gradients from one adjoint pass against bump-and-reprice, which
+// reprices the whole batch twice per input for central differences. Both
+// use the same samples, so they estimate the same pathwise derivative and
+// should agree to the bump's truncation error.
+////////////////////////////////////////////////////////////////////////////////
+static void benchmarkAdjoint(TBatchPlan *batch, TOptionPlan *plan, int nPlans,
+                             bool steal, TBasket *baskets) {
+  const int optionN = batch->optionN;
+  const int n = baskets[0].assetN;
+  const int gradientN = basketGradientN(n);
+  std::vector<real> gradient((size_t)optionN * gradientN);
+  std::vector<real> priceUp(optionN), inputUp(optionN), inputDown(optionN);
+  std::vector<double> bumped((size_t)optionN * gradientN);
+
+  TBatchPlan run = *batch;
+  for (int i = 0; i < nPlans; i++) plan[i].batch = &run;
+
+  printf("Adjoint gradient benchmark (%i inputs per basket):\n", gradientN);
+
+  run.greeks = false;
+  run.gradient = NULL;
+  const double priceTime = runBatch(&run, plan, nPlans, steal).time;
+
+  run = *batch;
+  run.greeks = true;
+  run.gradient = gradient.data();
+  run.gradientN = gradientN;
+  const double adjointTime = runBatch(&run, plan, nPlans, steal).time;
+
+  double bumpTime = 0;
+  for (int j = 0; j < gradientN; j++) {
+    real *input[2];
+    std::vector<real> value(optionN);
+
+    for (int side = 0; side < 2; side++) {
+      for (int i = 0; i < optionN; i++) {
+        basketInput(baskets[i], j, input);
+        if (side == 0) value[i] = *input[0];
+        const real h = basketBump(baskets[i], j);
+        const real x = setBasketInput(baskets[i], j,
+                                      side == 0 ? value[i] + h : value[i] - h);
+        (side == 0 ? inputUp : inputDown)[i] = x;
+      }
+      if (j >= 2 * n) factorBaskets(baskets, optionN);
+
+      run = *batch;
+      run.greeks = false;
+      run.gradient = NULL;
+      bumpTime += runBatch(&run, plan, nPlans, steal).time;
+
+      for (int i = 0; i < optionN; i++) {
+        const real price = batch->callValue[i].Expected;
+        if (side == 0) {
+          priceUp[i] = price;
+        } else {
+          bumped[(size_t)i * gradientN + j] =
+              ((double)priceUp[i] - price) /
+              ((double)inputUp[i] - inputDown[i]);
+        }
+      }
+    }
+
+    for (int i = 0; i < optionN; i++) setBasketInput(baskets[i], j, value[i]);
+    if (j >= 2 * n) factorBaskets(baskets, optionN);
+  }
+
+  // Relative L1 distance per input group
+  const char *groupNames[] = {"spot", "volatility", "correlation"};
+  const int groupFirst[] = {0, n, 2 * n, gradientN};
+  double distance[3] = {}, norm[3] = {};
+
+  for (int i = 0; i < optionN; i++) {
+    for (int g = 0; g < 3; g++) {
+      for (int j = groupFirst[g]; j < groupFirst[g + 1]; j++) {
+        const double fd = bumped[(size_t)i * gradientN + j];
+        distance[g] += fabs(gradient[(size_t)i * gradientN + j] - fd);
+        norm[g] += fabs(fd);
+      }
+    }
+  }
+
+  printf("  %-19s %10.3f ms\n", "price only", priceTime);
+  printf("  %-19s %10.3f ms, %7.2fx pricing\n", "adjoint", adjointTime,
+         adjointTime / priceTime);
+  printf("  %-19s %10.3f ms, %7.2fx pricing, %i repricings\n",
+         "finite differences", bumpTime, bumpTime / priceTime, 2 * gradientN);
+  printf("  Adjoint speedup over finite differences: %.2fx\n",
+         bumpTime / adjointTime);
+  for (int g = 0; g < 3; g++)
+    printf("  %s gradient vs. finite differences: L1 norm %E\n",
+           groupNames[g], norm[g] > 0 ? distance[g] / norm[g] : 0.0);
+
+  for (int i = 0; i < nPlans; i++) plan[i].batch = batch;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Fused one-step pricing against the sample buffer design it replaces. The
+// fused kernel generates each path block's normals into an L1-sized stack
+// buffer and prices them at once. The baseline first generates the normals
+// of the whole batch into a heap buffer, as a device kernel would into
+// global memory, and then prices them from there with
+// MonteCarloBufferedOption(). The baseline skips the scheduler and the final
+// reduction, which only favours it. Both price the same samples in the same
+// order, so their block moments must be bit-identical; returns whether they
+// are.
+////////////////////////////////////////////////////////////////////////////////
+static bool benchmarkFused(TBatchPlan *batch, TOptionPlan *plan, int nPlans,
+                           bool steal) {
+  const int optionN = batch->optionN;
+  const int REPEAT_N = 3;
+  std::vector<TBlockMoments> moments[2];
+  // Mode 0 prices from the sample buffer, mode 1 fused. The modes alternate
+  // over REPEAT_N rounds, and each keeps its fastest run.
+  double time[2] = {INFINITY, INFINITY};
+  double generateTime = 0, priceTime = 0, bufferBytes = 0;
+
+  // Time fn() run by nPlans threads, each taking every nPlans-th option
+  auto timeOptions = [&](const std::function<void(int)> &fn) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nPlans; t++)
+      threads.emplace_back([&, t] {
+        for (int opt = t; opt < optionN; opt += nPlans) fn(opt);
+      });
+    for (std::thread &thread : threads) thread.join();
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+  };
+
+  printf("Fused kernel benchmark (%i options x %i paths, best of %i):\n",
+         optionN, batch->pathN, REPEAT_N);
+
+  for (int r = 0; r < REPEAT_N; r++) {
+    for (int f = 0; f < 2; f++) {
+      TBatchPlan run = *batch;
+      for (int i = 0; i < nPlans; i++) plan[i].batch = &run;
+      initMonteCarloBatch(&run, nPlans, steal);
+
+      double generate = 0, price;
+      if (f == 0) {
+        // Option rows of whole Philox blocks, zero-filled on allocation so
+        // that page faults stay out of the timings
+        const int sampleN = run.antithetic ? run.pathN / 2 : run.pathN;
+        const size_t rowN = ((size_t)sampleN + 3) & ~(size_t)3;
+        std::vector<float> samples(rowN * optionN);
+        bufferBytes = (double)samples.size() * sizeof(float);
+
+        generate = timeOptions([&](int opt) {
+          normalGenerator(samples.data() + opt * rowN, 0, (int)(rowN / 4),
+                          philoxKey(run.seed), opt, 0);
+        });
+        price = timeOptions([&](int opt) {
+          MonteCarloBufferedOption(run, opt, samples.data() + opt * rowN);
+        });
+      } else {
+        auto start = std::chrono::steady_clock::now();
+        multiSolver(plan, nPlans);
+        price = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+      }
+
+      if (generate + price < time[f]) {
+        time[f] = generate + price;
+        if (f == 0) generateTime = generate, priceTime = price;
+      }
+      moments[f].assign(run.h_BlockMoments,
+                        run.h_BlockMoments + (size_t)optionN * run.blockN);
+      closeMonteCarloBatch(&run);
+    }
+  }
+
+  const bool identical =
+      memcmp(moments[0].data(), moments[1].data(),
+             moments[0].size() * sizeof(TBlockMoments)) == 0;
+
+  const double paths = (double)optionN * batch->pathN;
+  printf("  %-13s %10.3f ms, %E paths/sec (generate %.3f ms, price %.3f "
+         "ms)\n",
+         "sample buffer", time[0], paths / (time[0] * 0.001), generateTime,
+         priceTime);
+  printf("  %-13s %10.3f ms, %E paths/sec, %5.2fx sample buffer\n", "fused",
+         time[1], paths / (time[1] * 0.001), time[0] / time[1]);
+  printf("  Sample buffer: %.1f MiB written and read back, %.3f ms over "
+         "fused\n",
+         bufferBytes / (1024.0 * 1024.0), time[0] - time[1]);
+  printf("  Fused: %i bytes of normals per worker\n",
+         (int)((PATH_BLOCK_N + 8) * sizeof(float)));
+  printf("Fused block moments bit-identical to the sample buffer: %s\n",
+         identical ? "yes" : "no");
+
+  for (int i = 0; i < nPlans; i++) plan[i].batch = batch;
+  return identical;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Time every normal generator the host supports on optionN x pathN samples
+// and check that each reproduces the scalar samples exactly
+////////////////////////////////////////////////////////////////////////////////
+static void benchmarkNormals(int optionN, int pathN, uint64_t seed) {
+  const char *names[] = {"scalar", "avx2", "avx512"};
+  const int BLOCK_N = 1024;
+  std::vector<float> z(4 * BLOCK_N), reference(4 * BLOCK_N);
+  double scalarTime = 0;
+
+  printf("Normal generator benchmark (%i options x %i paths):\n", optionN,
+         pathN);
+
+  for (const char *name : names) {
+    TNormalGenerator generator = getNormalGenerator(name, NULL);
+    if (!generator) {
+      printf("  %-7s not supported by this host\n", name);
+      continue;
+    }
+
+    bool identical = true;
+    for (int i = 0; i < 64; i++) {
+      normalsScalar(reference.data(), i * BLOCK_N, BLOCK_N, philoxKey(seed), 0,
+                    0);
+      generator(z.data(), i * BLOCK_N, BLOCK_N, philoxKey(seed), 0, 0);
+      identical = identical && z == reference;
+    }
+
+    float checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int opt = 0; opt < optionN; opt++) {
+      for (int pos = 0; pos < pathN; pos += 4 * BLOCK_N) {
+        generator(z.data(), pos / 4, BLOCK_N, philoxKey(seed), opt, 0);
+        checksum += z[0];
+      }
+    }
+    double time = std::chrono::duration<double>(
+                      std::chrono::steady_clock::now() - start)
+                      .count();
+    if (generator == normalsScalar) scalarTime = time;
+
+    printf("  %-7s %10.3f ms, %E samples/sec, speedup %5.2fx, %s (%g)\n",
+           name, time * 1000.0, (double)optionN * pathN / time,
+           scalarTime > 0 ? scalarTime / time : 1.0,
+           identical ? "bit-identical to scalar" : "DIFFERS from scalar",
+           (double)checksum);
+  }
+}
+
+int main(int argc, char **argv) {
+  printf("%s Starting...\n\n", argv[0]);
+
+  if (checkCmdLineFlag(argc, argv, "help")) {
+    printf("Usage: %s [--devices=N] [--options=N] [--paths=N] [--seed=N] "
+           "[--chunk=N] [--scheduler=steal|static] "
+           "[--tolerance=X] [--round=N] [--antithetic] [--control] "
+           "[--qmc[=replicas]] [--mlmc[=levels]] [--steps=N] "
+           "[--payoff=call|lookback|asian|geometric-asian|"
+           "down-out|down-in|up-out|up-in|american-put|basket|digital] "
+           "[--barrier=F] [--model=gbm|heston|local-vol|merton] [--greeks] "
+           "[--assets=N] "
+           "[--bench-variance] [--bench-adjoint] "
+           "[--precision=float|compensated|mixed|double] "
+           "[--bench-precision] [--bench-fused] "
+           "[--normals=auto|scalar|avx2|avx512] [--bench-normals] [--cpu]\n",
+           argv[0]);
+    return EXIT_SUCCESS;
+  }
+
+  const int coreN = getHostCoreCount();
+  const int DEVICE_N = getCmdLineArgumentInt(argc, argv, "devices", coreN);
+  const int OPT_N = getCmdLineArgumentInt(argc, argv, "options", 256);
+  const int PATH_N = getCmdLineArgumentInt(argc, argv, "paths", 262144);
+  const uint64_t SEED =
+      (uint64_t)getCmdLineArgumentInt(argc, argv, "seed", 1234);
+  const int CHUNK_N = getCmdLineArgumentInt(argc, argv, "chunk", 65536);
+  const char *scheduler = getCmdLineArgument(argc, argv, "scheduler");
+  const bool STEAL = !scheduler || strcmp(scheduler, "static") != 0;
+  const double TOLERANCE = getCmdLineArgumentFloat(argc, argv, "tolerance", 0);
+  const int ROUND_N = getCmdLineArgumentInt(argc, argv, "round", CHUNK_N);
+  const bool ANTITHETIC = checkCmdLineFlag(argc, argv, "antithetic");
+  const bool CONTROL = checkCmdLineFlag(argc, argv, "control");
+  const bool BENCH_VARIANCE = checkCmdLineFlag(argc, argv, "bench-variance");
+  const int QMC_N = checkCmdLineFlag(argc, argv, "qmc")
+                        ? getCmdLineArgumentInt(argc, argv, "qmc", 16)
+                        : 0;
+  const int MLMC_N = checkCmdLineFlag(argc, argv, "mlmc")
+                         ? getCmdLineArgumentInt(argc, argv, "mlmc", 8)
+                         : 0;
+  const char *model = getCmdLineArgument(argc, argv, "model");
+  int MODEL = MODEL_GBM;
+  for (int m = 0; model && m <= MODEL_MERTON; m++)
+    if (strcmp(model, modelNames[m]) == 0) MODEL = m;
+  // Models other than GBM default to a fine grid: Heston and local
+  // volatility steps are discretised, and Merton jumps are counted per step
+  const int STEP_N = getCmdLineArgumentInt(argc, argv, "steps",
+                                           MODEL != MODEL_GBM ? 16 : 1);
+  const char *payoff = getCmdLineArgument(argc, argv, "payoff");
+  const TPayoffInfo *PAYOFF = getPayoffInfo(payoff);
+  // Barrier level as a multiple of the spot
+  const double BARRIER = getCmdLineArgumentFloat(
+      argc, argv, "barrier", PAYOFF && isUpBarrier(PAYOFF->type) ? 1.25 : 0.8);
+  const int ASSET_N = getCmdLineArgumentInt(argc, argv, "assets", 8);
+  const bool GREEKS = checkCmdLineFlag(argc, argv, "greeks");
+  const bool BENCH_ADJOINT = checkCmdLineFlag(argc, argv, "bench-adjoint");
+  const char *precision = getCmdLineArgument(argc, argv, "precision");
+  // Defaults to the build's real type
+  TPrecision PRECISION =
+      sizeof(real) == sizeof(double) ? PRECISION_DOUBLE : PRECISION_FLOAT;
+  for (int p = 0; precision && p < PRECISION_N; p++)
+    if (strcmp(precision, precisionNames[p]) == 0) PRECISION = (TPrecision)p;
+  const bool BENCH_PRECISION =
+      checkCmdLineFlag(argc, argv, "bench-precision");
+  const bool BENCH_FUSED = checkCmdLineFlag(argc, argv, "bench-fused");
+
+  const char *normals = getCmdLineArgument(argc, argv, "normals");
+  const char *normalsName = NULL;
+  normalGenerator = getNormalGenerator(normals, &normalsName);
+
+  if (!normalGenerator) {
+    fprintf(stderr, "Normal generator '%s' is not available\n", normals);
+    return EXIT_FAILURE;
+  }
+
+  if (!PAYOFF) {
+    fprintf(stderr, "Unknown payoff '%s'\n", payoff);
+    return EXIT_FAILURE;
+  }
+
+  if (DEVICE_N < 1 || OPT_N < 1 || PATH_N < 2 || CHUNK_N < 1 ||
+      ROUND_N < 1 || TOLERANCE < 0 || QMC_N < 0 || MLMC_N < 0 || STEP_N < 1 ||
+      ASSET_N < 1 || ASSET_N > MAX_BASKET_ASSETS) {
+    fprintf(stderr, "Invalid problem size\n");
+    return EXIT_FAILURE;
+  }
+
+  if (QMC_N > 0 && (ANTITHETIC || CONTROL || TOLERANCE > 0 || BENCH_VARIANCE)) {
+    fprintf(stderr, "--qmc runs plain fixed-size replicas; it does not combine "
+                    "with --antithetic, --control, --tolerance or "
+                    "--bench-variance\n");
+    return EXIT_FAILURE;
+  }
+
+  // Level streams leave MLMC_STREAM_SHIFT bits for the fine steps
+  if (MLMC_N > 0 &&
+      (QMC_N > 0 || ANTITHETIC || CONTROL || GREEKS || BENCH_VARIANCE ||
+       BENCH_PRECISION || PAYOFF->type == PAYOFF_AMERICAN_PUT ||
+       PAYOFF->type == PAYOFF_BASKET_CALL || MLMC_N > MLMC_STREAM_SHIFT ||
+       ((int64_t)STEP_N << (MLMC_N - 1)) >= (1 << MLMC_STREAM_SHIFT))) {
+    fprintf(stderr, "--mlmc refines single-asset European payoffs over at "
+                    "most 2^%i fine steps; it does not combine with --qmc, "
+                    "--antithetic, --control, --greeks or the benchmarks\n",
+            MLMC_STREAM_SHIFT);
+    return EXIT_FAILURE;
+  }
+
+  if (PAYOFF->type == PAYOFF_AMERICAN_PUT &&
+      (ANTITHETIC || CONTROL || TOLERANCE > 0 || QMC_N > 0 || BENCH_VARIANCE)) {
+    fprintf(stderr, "--payoff=american-put regresses over one fixed set of "
+                    "plain paths; it does not combine with --antithetic, "
+                    "--control, --tolerance, --qmc or --bench-variance\n");
+    return EXIT_FAILURE;
+  }
+
+  if (GREEKS && PAYOFF->type == PAYOFF_AMERICAN_PUT) {
+    fprintf(stderr, "--greeks is not available for %s options\n",
+            PAYOFF->name);
+    return EXIT_FAILURE;
+  }
+
+  if (model && strcmp(model, modelNames[MODEL]) != 0) {
+    fprintf(stderr, "Unknown model '%s'\n", model);
+    return EXIT_FAILURE;
+  }
+
+  if (MODEL != MODEL_GBM &&
+      (PAYOFF->type != PAYOFF_CALL || QMC_N > 0 || MLMC_N > 0 || GREEKS ||
+       BENCH_VARIANCE || BENCH_PRECISION || BENCH_FUSED)) {
+    fprintf(stderr, "--model=%s prices European calls by pseudo-random "
+                    "paths; it does not combine with other payoffs, --qmc, "
+                    "--mlmc, --greeks or the benchmarks\n",
+            modelNames[MODEL]);
+    return EXIT_FAILURE;
+  }
+
+  if (precision && strcmp(precision, precisionNames[PRECISION]) != 0) {
+    fprintf(stderr, "Unknown precision '%s'\n", precision);
+    return EXIT_FAILURE;
+  }
+
+  if (BENCH_PRECISION && (PAYOFF->type != PAYOFF_CALL || STEP_N > 1)) {
+    fprintf(stderr, "--bench-precision runs one-step European calls\n");
+    return EXIT_FAILURE;
+  }
+
+  if (BENCH_FUSED && (PAYOFF->type != PAYOFF_CALL || STEP_N > 1 ||
+                      MLMC_N > 0 || QMC_N > 0 || TOLERANCE > 0)) {
+    fprintf(stderr, "--bench-fused runs fixed-size pseudo-random one-step "
+                    "European calls\n");
+    return EXIT_FAILURE;
+  }
+
+  if (BENCH_ADJOINT && PAYOFF->type != PAYOFF_BASKET_CALL) {
+    fprintf(stderr, "--bench-adjoint needs --payoff=basket\n");
+    return EXIT_FAILURE;
+  }
+
+  printf("Number of host cores:    %i\n", coreN);
+  printf("Number of devices:       %i\n", DEVICE_N);
+  printf("Total number of options: %i\n", OPT_N);
+  printf("Number of paths:         %i\n", PATH_N);
+  printf("Scheduler:               %s\n", STEAL ? "work-stealing" : "static");
+  printf("Normal generator:        %s\n", normalsName);
+  printf("Precision:               %s\n", precisionNames[PRECISION]);
+  printf("Payoff:                  %s, %i time step%s\n", PAYOFF->name,
+         STEP_N, STEP_N > 1 ? "s" : "");
+  if (MODEL == MODEL_HESTON)
+    printf("Model:                   Heston, quadratic-exponential steps\n");
+  if (MODEL == MODEL_LOCAL_VOL)
+    printf("Model:                   local volatility, %i options per "
+           "surface\n", LOCALVOL_GROUP_N);
+  if (MODEL == MODEL_MERTON)
+    printf("Model:                   Merton jump-diffusion\n");
+  if (isBarrier(PAYOFF->type))
+    printf("Barrier:                 %.3f x spot\n", BARRIER);
+  if (PAYOFF->type == PAYOFF_BASKET_CALL)
+    printf("Assets per basket:       %i\n", ASSET_N);
+
+  if (checkCmdLineFlag(argc, argv, "bench-normals")) {
+    benchmarkNormals(OPT_N, PATH_N, SEED);
+    return EXIT_SUCCESS;
+  }
+
+  std::vector<TOptionData> optionData(OPT_N);
+  std::vector<TOptionValue> callValue(OPT_N);
+  std::vector<TDeviceInfo> devices(DEVICE_N);
+  std::vector<TOptionPlan> optionSolver(DEVICE_N);
+  std::vector<TBasket> baskets;
+  std::vector<THeston> hestons;
+  std::vector<TMerton> mertons;
+  std::vector<TLocalVol> surfaces;
+  // Displaced diffusion volatility and floor of each surface
+  std::vector<double> displacedV, displacedFloor;
+  // Basket gradients, when computed
+  std::vector<real> gradient(
+      GREEKS && PAYOFF->type == PAYOFF_BASKET_CALL
+          ? (size_t)OPT_N * basketGradientN(ASSET_N)
+          : 0);
+  TOptionBatch options;
+  TBatchPlan batch;
+
+  printf("main(): generating input data...\n");
+  std::mt19937 gen(123);
+
+  for (int i = 0; i < OPT_N; i++) {
+    optionData[i].S = randFloat(gen, 5.0f, 50.0f);
+    optionData[i].X = randFloat(gen, 10.0f, 25.0f);
+    optionData[i].T = randFloat(gen, 1.0f, 5.0f);
+    optionData[i].R = 0.06f;
+    optionData[i].V = 0.10f;
+    callValue[i] = TOptionValue();
+    callValue[i].Expected = -1.0f;
+    callValue[i].Confidence = -1.0f;
+  }
+
+  // One equally weighted basket per option around the option's spot, with
+  // one-factor correlations rho_ab = beta_a beta_b
+  if (PAYOFF->type == PAYOFF_BASKET_CALL) {
+    std::mt19937 basketGen(456);
+    std::vector<real> beta(ASSET_N);
+    baskets.resize(OPT_N);
+
+    for (int i = 0; i < OPT_N; i++) {
+      TBasket &basket = baskets[i];
+      initBasket(&basket, ASSET_N);
+
+      for (int a = 0; a < ASSET_N; a++) {
+        basket.S[a] = optionData[i].S * randFloat(basketGen, 0.8f, 1.2f);
+        basket.V[a] = randFloat(basketGen, 0.1f, 0.3f);
+        basket.Weight[a] = (real)(1.0 / ASSET_N);
+        beta[a] = randFloat(basketGen, 0.3f, 0.9f);
+      }
+
+      for (int a = 0; a < ASSET_N; a++)
+        for (int b = 0; b < ASSET_N; b++)
+          basket.Correlation[a * ASSET_N + b] = a == b ? 1 : beta[a] * beta[b];
+    }
+
+    if (factorBaskets(baskets.data(), OPT_N) >= 0) {
+      fprintf(stderr, "Basket correlation is not positive definite\n");
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Heston parameters per option around the option's variance V^2, mostly
+  // outside the Feller condition 2 kappa theta >= xi^2, where the variance
+  // reaches zero
+  if (MODEL == MODEL_HESTON) {
+    std::mt19937 hestonGen(789);
+    hestons.resize(OPT_N);
+
+    for (int i = 0; i < OPT_N; i++) {
+      const real var = optionData[i].V * optionData[i].V;
+      hestons[i].kappa = randFloat(hestonGen, 1.0f, 3.0f);
+      hestons[i].theta = var * randFloat(hestonGen, 1.0f, 4.0f);
+      hestons[i].xi = randFloat(hestonGen, 0.2f, 0.6f);
+      hestons[i].rho = randFloat(hestonGen, -0.8f, -0.3f);
+    }
+  }
+
+  // Merton parameters per option: mostly downward jumps, up to one a year
+  // on average
+  if (MODEL == MODEL_MERTON) {
+    std::mt19937 mertonGen(1213);
+    mertons.resize(OPT_N);
+
+    for (int i = 0; i < OPT_N; i++) {
+      mertons[i].lambda = randFloat(mertonGen, 0.1f, 1.0f);
+      mertons[i].muJ = randFloat(mertonGen, -0.25f, 0.05f);
+      mertons[i].deltaJ = randFloat(mertonGen, 0.05f, 0.3f);
+    }
+  }
+
+  // Local volatility surfaces of displaced diffusions, whose calls have
+  // closed forms: sigma(t, S) = V_d (1 - floor exp(Rt) / S) sampled on 33
+  // times to the group's last maturity and 64 log-moneyness nodes over
+  // +/-2. Options of a group share the spot of its first option. The floor
+  // stays below every strike of the group after growing to maturity, so no
+  // call degenerates into a forward.
+  if (MODEL == MODEL_LOCAL_VOL) {
+    const int groupN = (OPT_N + LOCALVOL_GROUP_N - 1) / LOCALVOL_GROUP_N;
+    const int timeN = 33, spotN = 64;
+    static_assert(timeN >= 2 && spotN >= 2 && spotN <= MAX_LOCALVOL_SPOT_N,
+                  "local volatility grid rejected by initLocalVol");
+    const double xFirst = -2, dx = 4.0 / (spotN - 1);
+    std::mt19937 surfaceGen(1011);
+    std::vector<double> sigma((size_t)timeN * spotN);
+    surfaces.resize(groupN);
+    displacedV.resize(groupN);
+    displacedFloor.resize(groupN);
+
+    for (int g = 0; g < groupN; g++) {
+      const int first = g * LOCALVOL_GROUP_N;
+      const int last = std::min(first + LOCALVOL_GROUP_N, OPT_N);
+      const double spot = optionData[first].S;
+      const double R = optionData[first].R;
+      double T = 0, base = spot;
+
+      for (int i = first; i < last; i++) {
+        optionData[i].S = (real)spot;
+        T = std::max(T, (double)optionData[i].T);
+        base = std::min(base, (double)optionData[i].X);
+      }
+      displacedV[g] = randFloat(surfaceGen, 0.15f, 0.3f);
+      displacedFloor[g] = base * randFloat(surfaceGen, 0.2f, 0.5f);
+
+      const double dt = T / (timeN - 1);
+      for (int j = 0; j < timeN; j++)
+        for (int i = 0; i < spotN; i++) {
+          const double S = spot * exp(xFirst + i * dx);
+          sigma[(size_t)j * spotN + i] =
+              displacedV[g] *
+              std::max(1 - displacedFloor[g] * exp(R * j * dt) / S, 0.0);
+        }
+      initLocalVol(&surfaces[g], timeN, spotN, spot, dt, xFirst, dx);
+      fitLocalVol(&surfaces[g], sigma.data());
+    }
+  }
+
+  printf("main(): starting %i devices...\n", DEVICE_N);
+  partitionDevices(devices.data(), DEVICE_N, coreN);
+
+  initOptionBatch(&options, optionData.data(), OPT_N);
+  // The variance benchmark always runs adaptively, and multilevel runs
+  // always to a root-mean-square error
+  const double tolerance =
+      TOLERANCE == 0 ? (BENCH_VARIANCE ? 0.01 : MLMC_N > 0 ? 0.05 : 0)
+                     : TOLERANCE;
+  for (int i = 0; i < OPT_N; i++) {
+    options.Tolerance[i] = (real)tolerance;
+    options.Payoff[i] = PAYOFF->type;
+    options.Barrier[i] = (real)(BARRIER * optionData[i].S);
+    options.Basket[i] = i;
+    options.Model[i] = MODEL;
+    options.Surface[i] = i / LOCALVOL_GROUP_N;
+  }
+  options.baskets = baskets.data();
+  options.heston = hestons.data();
+  options.merton = mertons.data();
+  options.surfaces = surfaces.data();
+
+  batch.options = &options;
+  batch.callValue = callValue.data();
+  batch.optionN = OPT_N;
+  batch.pathN = PATH_N;
+  batch.chunkPathN = CHUNK_N;
+  batch.seed = SEED;
+  batch.antithetic = ANTITHETIC;
+  batch.controlVariate = CONTROL;
+  batch.qmcReplicaN = QMC_N;
+  batch.levelN = MLMC_N;
+  batch.stepN = STEP_N;
+  batch.greeks = GREEKS;
+  batch.precision = PRECISION;
+  batch.gradient = gradient.empty() ? NULL : gradient.data();
+  batch.gradientN = basketGradientN(ASSET_N);
+  // Adaptive runs add ROUND_N paths per round; fixed runs take one round
+  const int roundChunkN = (ROUND_N + CHUNK_N - 1) / CHUNK_N;
+  batch.roundChunkN = TOLERANCE > 0 ? roundChunkN : 0;
+  printf("Paths per chunk:         %i\n",
+         (CHUNK_N + PATH_BLOCK_N - 1) / PATH_BLOCK_N * PATH_BLOCK_N);
+  if (QMC_N > 0)
+    printf("Sampling:                Sobol, %i digit-shifted replicas\n",
+           QMC_N);
+  else if (MLMC_N > 0)
+    printf("Sampling:                multilevel, up to %i levels of %i x 2^l "
+           "steps, RMSE %f\n",
+           MLMC_N, STEP_N, tolerance);
+  else
+    printf("Sampling:                %s%s\n",
+           ANTITHETIC ? "antithetic" : "plain",
+           CONTROL ? ", control variate" : "");
+  if (TOLERANCE > 0 && MLMC_N == 0) {
+    printf("Adaptive tolerance:      %f\n", TOLERANCE);
+    printf("Paths per round:         %i\n",
+           roundChunkN * ((CHUNK_N + PATH_BLOCK_N - 1) / PATH_BLOCK_N *
+                          PATH_BLOCK_N));
+  }
+
+  // Get option count for each device
+  for (int i = 0; i < DEVICE_N; i++)
+    optionSolver[i].optionCount = OPT_N / DEVICE_N;
+
+  // Take into account cases with "odd" option counts
+  for (int i = 0; i < (OPT_N % DEVICE_N); i++) optionSolver[i].optionCount++;
+
+  // Assign option ranges and device IDs to plans
+  int gpuBase = 0;
+
+  for (int i = 0; i < DEVICE_N; i++) {
+    optionSolver[i].device = devices[i];
+    optionSolver[i].optionFirst = gpuBase;
+    optionSolver[i].optionData = optionData.data() + gpuBase;
+    optionSolver[i].callValue = callValue.data() + gpuBase;
+    optionSolver[i].batch = &batch;
+    gpuBase += optionSolver[i].optionCount;
+  }
+
+  if (BENCH_VARIANCE) {
+    benchmarkVariance(&batch, optionSolver.data(), DEVICE_N, STEAL,
+                      roundChunkN);
+    closeOptionBatch(&options);
+    for (TBasket &basket : baskets) closeBasket(&basket);
+    return EXIT_SUCCESS;
+  }
+
+  if (BENCH_PRECISION) {
+    const bool passed = benchmarkPrecision(&batch, optionSolver.data(),
+                                           DEVICE_N, STEAL, optionData.data());
+    closeOptionBatch(&options);
+    printf(passed ? "Test passed\n" : "Test failed!\n");
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+  }
+
+  if (BENCH_ADJOINT) {
+    benchmarkAdjoint(&batch, optionSolver.data(), DEVICE_N, STEAL,
+                     baskets.data());
+    closeOptionBatch(&options);
+    for (TBasket &basket : baskets) closeBasket(&basket);
+    return EXIT_SUCCESS;
+  }
+
+  // The benchmark's runs are checked against each other; the regular run
+  // below still checks the prices
+  const bool fusedPassed =
+      !BENCH_FUSED ||
+      benchmarkFused(&batch, optionSolver.data(), DEVICE_N, STEAL);
+
+  TRunStats stats = runBatch(&batch, optionSolver.data(), DEVICE_N, STEAL);
+  const double time = stats.time;
+  closeOptionBatch(&options);
+
+  float minTime = optionSolver[0].time, maxTime = optionSolver[0].time;
+
+  for (int i = 0; i < DEVICE_N; i++) {
+    const TOptionPlan &plan = optionSolver[i];
+    printf("  device %2i: cores %3i..%3i, %5i tasks (%5i stolen), "
+           "%10.3f ms, %E paths/sec\n",
+           i, plan.device.coreFirst,
+           plan.device.coreFirst + plan.device.coreCount - 1, plan.tasksDone,
+           plan.tasksStolen, plan.time,
+           plan.time > 0 ? plan.pathsDone / (plan.time * 0.001) : 0.0);
+    if (plan.time < minTime) minTime = plan.time;
+    if (plan.time > maxTime) maxTime = plan.time;
+  }
+
+  printf("Device finish spread: %f ms\n", maxTime - minTime);
+  printf("Result checksum: %016llx\n",
+         (unsigned long long)resultChecksum(callValue.data(), OPT_N, GREEKS,
+                                                  gradient));
+  if (MLMC_N > 0) {
+    printf("Rounds: %i, options within RMSE: %i of %i, levels used: %i\n",
+           stats.roundN, stats.convergedN, OPT_N, stats.levelN);
+    printf("Paths simulated: %lld over all levels\n", stats.pathsDone);
+    printf("Median cost reduction vs. single-level sampling: %.3fx\n",
+           stats.varianceRatio);
+  } else if (TOLERANCE > 0) {
+    printf("Rounds: %i, options converged: %i of %i\n", stats.roundN,
+           stats.convergedN, OPT_N);
+    printf("Paths simulated: %lld of %lld (%.1f%%)\n", stats.pathsDone,
+           (long long)OPT_N * PATH_N,
+           100.0 * stats.pathsDone / ((double)OPT_N * PATH_N));
+  }
+  if (ANTITHETIC || CONTROL || QMC_N > 0)
+    printf("Median variance reduction vs. plain sampling: %.3fx "
+           "(%i options with unresolved residual variance left out)\n",
+           stats.varianceRatio, stats.unresolvedN);
+  printf("Solver time:   %f ms\n", time);
+  printf("Options per sec.: %f\n", OPT_N / (time * 0.001));
+
+  // The double-precision CPU run replays one-step European samples
+  if (checkCmdLineFlag(argc, argv, "cpu") && STEP_N == 1 &&
+      PAYOFF->type == PAYOFF_CALL && MODEL == MODEL_GBM) {
+    const int CPU_OPT_N = OPT_N < 8 ? OPT_N : 8;
+    std::vector<float> normals(PATH_N + 4);
+    std::vector<double> samples(PATH_N);
+
+    printf("main(): running CPU MonteCarlo on %i options...\n", CPU_OPT_N);
+    for (int i = 0; i < CPU_OPT_N; i++) {
+      TOptionValue callValueCPU;
+      // Same samples as the devices, so only the accumulation precision differs
+      normalsScalar(normals.data(), 0, (PATH_N + 3) / 4, philoxKey(SEED), i, 0);
+      for (int pos = 0; pos < PATH_N; pos++) samples[pos] = normals[pos];
+      MonteCarloCPU(callValueCPU, optionData[i], samples.data(), PATH_N);
+      printf("  option %i: device %f, CPU %f (+/- %f)\n", i,
+             (double)callValue[i].Expected, (double)callValueCPU.Expected,
+             (double)callValueCPU.Confidence);
+    }
+  }
+
+  // Multilevel runs converge to continuous monitoring, step count 0 of the
+  // references
+  const int referenceStepN = MLMC_N > 0 ? 0 : STEP_N;
+  printf("main(): comparing Monte Carlo and %s%s results...\n",
+         MLMC_N > 0 ? "continuously monitored " : "",
+         MODEL == MODEL_HESTON      ? "semi-analytic Heston"
+         : MODEL == MODEL_LOCAL_VOL ? "displaced diffusion"
+         : MODEL == MODEL_MERTON    ? "Merton series"
+                                    : PAYOFF->reference);
+  double sumDelta = 0, sumRef = 0, sumReserve = 0, sumSquares = 0;
+
+  for (int i = 0; i < OPT_N; i++) {
+    const int group = i / LOCALVOL_GROUP_N;
+    TOptionData displaced = optionData[i];
+    double callValueRef;
+
+    if (MODEL == MODEL_HESTON) {
+      callValueRef = HestonCall(optionData[i], hestons[i]);
+    } else if (MODEL == MODEL_LOCAL_VOL) {
+      displaced.V = (real)displacedV[group];
+      callValueRef = DisplacedDiffusionCall(displaced, displacedFloor[group]);
+    } else if (MODEL == MODEL_MERTON) {
+      callValueRef = MertonCall(optionData[i], mertons[i]);
+    } else {
+      callValueRef = referencePrice(PAYOFF->type, optionData[i],
+                                    referenceStepN,
+                                    (real)(BARRIER * optionData[i].S),
+                                    baskets.empty() ? NULL : &baskets[i]);
+    }
+    double delta = fabs(callValueRef - callValue[i].Expected);
+    sumDelta += delta;
+    sumRef += fabs(callValueRef);
+    sumSquares += delta * delta;
+    if (delta > 1e-6) sumReserve += callValue[i].Confidence / delta;
+  }
+
+  sumReserve /= OPT_N;
+  const double rmsError = sqrt(sumSquares / OPT_N);
+  printf("L1 norm: %E\n", sumDelta / sumRef);
+  printf("Average reserve: %f\n", sumReserve);
+  if (MLMC_N > 0)
+    printf("RMS error: %E (target %f)\n", rmsError, tolerance);
+
+  // Basket gradients against differences of Levy's price, which like the
+  // price itself is only an approximation, so they are reported only
+  if (!gradient.empty()) {
+    const int gradientN = basketGradientN(ASSET_N);
+    const char *groupNames[] = {"Spot", "Volatility", "Correlation"};
+    const int groupFirst[] = {0, ASSET_N, 2 * ASSET_N, gradientN};
+    double distance[3] = {}, norm[3] = {};
+    std::vector<double> reference(gradientN);
+
+    for (int i = 0; i < OPT_N; i++) {
+      referenceBasketGradient(reference.data(), baskets[i], optionData[i]);
+      for (int g = 0; g < 3; g++) {
+        for (int j = groupFirst[g]; j < groupFirst[g + 1]; j++) {
+          distance[g] += fabs(gradient[(size_t)i * gradientN + j] -
+                              reference[j]);
+          norm[g] += fabs(reference[j]);
+        }
+      }
+    }
+
+    for (int g = 0; g < 3; g++)
+      if (norm[g] > 0)
+        printf("%s gradient: L1 norm %E (approximate reference)\n",
+               groupNames[g], distance[g] / norm[g]);
+  }
+
+  for (TBasket &basket : baskets) closeBasket(&basket);
+  for (TLocalVol &surface : surfaces) closeLocalVol(&surface);
+
+  // Greeks must lie within their confidence widths of the reference, like
+  // the price
+  const char *greekNames[GREEK_N] = {"Delta", "Vega", "Rho"};
+  bool greeksPassed = true;
+
+  for (int k = 0; GREEKS && gradient.empty() && k < GREEK_N; k++) {
+    double greekDelta = 0, greekRef = 0, greekReserve = 0;
+
+    for (int i = 0; i < OPT_N; i++) {
+      double greeks[GREEK_N];
+      referenceGreeks(greeks, PAYOFF->type, optionData[i], STEP_N,
+                      (real)(BARRIER * optionData[i].S));
+      double delta = fabs(greeks[k] - callValue[i].Greek[k]);
+      greekDelta += delta;
+      greekRef += fabs(greeks[k]);
+      if (delta > 1e-6)
+        greekReserve += callValue[i].GreekConfidence[k] / delta;
+    }
+
+    greekReserve /= OPT_N;
+    printf("%s: L1 norm %E, average reserve %f%s\n", greekNames[k],
+           greekDelta / greekRef, greekReserve,
+           PAYOFF->exactReference ? "" : " (approximate reference)");
+    // Differences of an approximate price say little about its Greeks, so
+    // only exact references gate the test
+    if (PAYOFF->exactReference) greeksPassed &= greekReserve > 1.0f;
+  }
+
+  // Approximate references (the O(1 / steps) lookback correction, Levy's
+  // Asian and basket moment matches) carry errors of their own that soon exceed the
+  // confidence width; hold them to 1% instead. Multilevel estimates include
+  // the bias, so exact references hold them to twice the target RMSE; the
+  // continuous lookback is exact.
+  const bool exactReference =
+      PAYOFF->exactReference ||
+      (MLMC_N > 0 && PAYOFF->type == PAYOFF_LOOKBACK_CALL);
+  bool passed = sumDelta / sumRef < 1e-2;
+  if (exactReference)
+    passed = MLMC_N > 0 ? rmsError <= 2 * tolerance : sumReserve > 1.0f;
+  passed = passed && greeksPassed && fusedPassed;
+  printf(passed ? "Test passed\n" : "Test failed!\n");
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
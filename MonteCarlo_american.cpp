@@ -0,0 +1,172 @@
+////////////////////////////////////////////////////////////////////////////////
+// Longstaff-Schwartz American pricing with backward Brownian-bridge paths
+////////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include "MonteCarlo_american.h"
+#include "MonteCarlo_normal.h"
+#include "MonteCarlo_reduction.h"
+
+// Unique entries of the normal equations: the upper triangle of B'B followed
+// by B'y, for the basis B = (1, s, s^2)
+const int NORMAL_SUM_N = 9;
+
+////////////////////////////////////////////////////////////////////////////////
+// Solve the symmetric 3 x 3 normal equations by Gaussian elimination with
+// partial pivoting. Returns false when they are (near) singular, e.g. with
+// too few in-the-money paths to fit.
+////////////////////////////////////////////////////////////////////////////////
+static bool solveNormalEquations(const double *sums, double *beta) {
+  const int N = AMERICAN_BASIS_N;
+  double a[N][N + 1] = {{sums[0], sums[1], sums[2], sums[6]},
+                        {sums[1], sums[3], sums[4], sums[7]},
+                        {sums[2], sums[4], sums[5], sums[8]}};
+
+  for (int col = 0; col < N; col++) {
+    int pivot = col;
+    for (int row = col + 1; row < N; row++)
+      if (fabs(a[row][col]) > fabs(a[pivot][col])) pivot = row;
+    if (fabs(a[pivot][col]) < 1e-12 * (fabs(a[0][0]) + 1)) return false;
+    for (int c = 0; c <= N; c++) std::swap(a[col][c], a[pivot][c]);
+
+    for (int row = col + 1; row < N; row++) {
+      const double f = a[row][col] / a[col][col];
+      for (int c = col; c <= N; c++) a[row][c] -= f * a[col][c];
+    }
+  }
+
+  for (int row = N - 1; row >= 0; row--) {
+    double v = a[row][N];
+    for (int c = row + 1; c < N; c++) v -= a[row][c] * beta[c];
+    beta[row] = v / a[row][row];
+  }
+
+  return true;
+}
+
+void MonteCarloAmerican(const TBatchPlan &batch, int option) {
+  const TOptionBatch &options = *batch.options;
+  const int pathN = batch.pathN;
+  const int M = batch.stepN;
+  const int blockN = (pathN + PATH_BLOCK_N - 1) / PATH_BLOCK_N;
+  const real S0 = options.S[option];
+  const real X = options.X[option];
+  const double T = options.T[option];
+  const double R = options.R[option];
+  const double V = options.V[option];
+  const double dt = T / M;
+  const real discountDt = (real)exp(-R * dt);
+  const TPhiloxKey key = philoxKey(batch.seed);
+
+  // Brownian value, price and cash flow (discounted to the current date)
+  thread_local std::vector<real> W, S, cash;
+  thread_local std::vector<double> blockSums;
+  W.resize(pathN);
+  S.resize(pathN);
+  cash.resize(pathN);
+  blockSums.resize((size_t)NORMAL_SUM_N * blockN);
+
+  alignas(64) float z[PATH_BLOCK_N];
+
+  for (int k = M; k >= 1; k--) {
+    const double t = k * dt;
+    const real drift = (real)((R - 0.5 * V * V) * t);
+    // W(t_k) = W(t_k+1) t_k / t_k+1 + sqrt(dt t_k / t_k+1) z
+    const real bridgeWeight = (real)((double)k / (k + 1));
+    const real bridgeStdDev =
+        k == M ? (real)sqrt(T) : (real)sqrt(dt * k / (k + 1));
+
+    // Step back, and accumulate the regression over in-the-money paths
+    for (int b = 0; b < blockN; b++) {
+      const int first = b * PATH_BLOCK_N;
+      int n = pathN - first;
+      if (n > PATH_BLOCK_N) n = PATH_BLOCK_N;
+
+      normalGenerator(z, first / 4, (n + 3) / 4, key, option, k - 1);
+
+      double lanes[NORMAL_SUM_N][REDUCTION_LANES] = {};
+
+      for (int i = 0; i < n; i++) {
+        const int p = first + i;
+        W[p] = (k == M ? 0 : W[p] * bridgeWeight) + bridgeStdDev * z[i];
+        S[p] = S0 * std::exp(drift + (real)V * W[p]);
+        cash[p] = k == M ? (S[p] < X ? X - S[p] : 0) : cash[p] * discountDt;
+
+        if (k == M || S[p] >= X) continue;
+
+        const int lane = i % REDUCTION_LANES;
+        const double s = (double)S[p] / X, s2 = s * s, y = cash[p];
+        lanes[0][lane] += 1;
+        lanes[1][lane] += s;
+        lanes[2][lane] += s2;
+        lanes[3][lane] += s2;
+        lanes[4][lane] += s2 * s;
+        lanes[5][lane] += s2 * s2;
+        lanes[6][lane] += y;
+        lanes[7][lane] += s * y;
+        lanes[8][lane] += s2 * y;
+      }
+
+      for (int j = 0; j < NORMAL_SUM_N; j++)
+        blockSums[(size_t)j * blockN + b] = treeSum(lanes[j], REDUCTION_LANES);
+    }
+
+    if (k == M) continue;
+
+    double sums[NORMAL_SUM_N], beta[AMERICAN_BASIS_N];
+    for (int j = 0; j < NORMAL_SUM_N; j++)
+      sums[j] = treeSum(blockSums.data() + (size_t)j * blockN, blockN);
+    if (sums[0] < AMERICAN_BASIS_N || !solveNormalEquations(sums, beta))
+      continue;
+
+    // Exercise where the payoff beats the estimated continuation value
+    for (int p = 0; p < pathN; p++) {
+      if (S[p] >= X) continue;
+      const double s = (double)S[p] / X;
+      const double continuation = beta[0] + s * (beta[1] + s * beta[2]);
+      if (X - S[p] > continuation) cash[p] = X - S[p];
+    }
+  }
+
+  // Block moments of the cash flows at maturity value, so the common
+  // reduction discounts them like every other payoff. The whole block is at
+  // hand, so its mean and M2 are taken in two exact passes.
+  const real toMaturity =
+      (real)((double)discountDt / (double)options.DiscountRT[option]);
+  TBlockMoments *moments = batch.h_BlockMoments + option * batch.blockN;
+
+  for (int b = 0; b < blockN; b++) {
+    const int first = b * PATH_BLOCK_N;
+    const int n = pathN - first < PATH_BLOCK_N ? pathN - first : PATH_BLOCK_N;
+    real lanes[REDUCTION_LANES] = {};
+
+    for (int i = 0; i < n; i++)
+      lanes[i % REDUCTION_LANES] += cash[first + i] * toMaturity;
+    const real mean = treeSum(lanes, REDUCTION_LANES) / n;
+
+    for (int l = 0; l < REDUCTION_LANES; l++) lanes[l] = 0;
+    for (int i = 0; i < n; i++) {
+      const real d = cash[first + i] * toMaturity - mean;
+      lanes[i % REDUCTION_LANES] += d * d;
+    }
+
+    moments[b] = TBlockMoments();
+    moments[b].n = n;
+    moments[b].mean[MOMENT_PAYOFF] = mean;
+    moments[b].m2[MOMENT_PAYOFF] = treeSum(lanes, REDUCTION_LANES);
+  }
+
+  // Exercise at inception if that beats holding: every path is then worth
+  // exactly X - S0
+  const double holdValue =
+      treeSum(moments, blockN).mean[MOMENT_PAYOFF] * options.DiscountRT[option];
+  if (X - S0 > holdValue) {
+    const real y = (real)((X - S0) / (double)options.DiscountRT[option]);
+    for (int b = 0; b < blockN; b++) {
+      moments[b].mean[MOMENT_PAYOFF] = y;
+      moments[b].m2[MOMENT_PAYOFF] = 0;
+    }
+  }
+}
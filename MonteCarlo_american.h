@@ -0,0 +1,25 @@
+#ifndef MONTECARLO_AMERICAN_H
+#define MONTECARLO_AMERICAN_H
+
+#include "MonteCarlo_common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Longstaff-Schwartz pricing of options exercisable at the stepN dates
+// t_k = k T / stepN (and at inception). Backward induction needs every path
+// of the option at once, so an American option is one whole-option task.
+//
+// Paths are built backwards in time with the Brownian bridge: W(T) first,
+// then W(t_k) from W(t_k+1) and a fresh normal, so only the current step's
+// state is stored (the Brownian value, price and cash flow of each path)
+// rather than a paths x steps matrix. At each date the continuation value
+// is regressed on 1, S / X and (S / X)^2 over the in-the-money paths; the
+// normal equations are accumulated per path block in fixed-shape lanes and
+// solved in double precision.
+////////////////////////////////////////////////////////////////////////////////
+const int AMERICAN_BASIS_N = 3;
+
+// Price all batch.pathN paths of one option, writing the block sums of its
+// discounted cash flows (expressed at maturity, as for every other payoff)
+void MonteCarloAmerican(const TBatchPlan &batch, int option);
+
+#endif
@@ -0,0 +1,236 @@
+////////////////////////////////////////////////////////////////////////////////
+// Correlated multi-asset basket options
+////////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+#include <vector>
+
+#include "MonteCarlo_basket.h"
+#include "MonteCarlo_path.h"
+#include "MonteCarlo_reduction.h"
+#include "MonteCarlo_sobol.h"
+
+// Rows of the Cholesky factor applied per pass over the tile's normals
+const int ROW_BLOCK = 4;
+
+// Sum of a[i] * b[i] over a tile, in interleaved lanes
+template <class B>
+static real tileDot(const real *a, const B *b, int n) {
+  real lanes[REDUCTION_LANES] = {};
+  int i = 0;
+
+  for (; i + REDUCTION_LANES <= n; i += REDUCTION_LANES)
+    for (int l = 0; l < REDUCTION_LANES; l++) lanes[l] += a[i + l] * b[i + l];
+  for (; i < n; i++) lanes[i % REDUCTION_LANES] += a[i] * b[i];
+
+  return treeSum(lanes, REDUCTION_LANES);
+}
+
+static real tileSum(const real *a, int n) {
+  real lanes[REDUCTION_LANES] = {};
+  int i = 0;
+
+  for (; i + REDUCTION_LANES <= n; i += REDUCTION_LANES)
+    for (int l = 0; l < REDUCTION_LANES; l++) lanes[l] += a[i + l];
+  for (; i < n; i++) lanes[i % REDUCTION_LANES] += a[i];
+
+  return treeSum(lanes, REDUCTION_LANES);
+}
+
+void initBasket(TBasket *basket, int assetN) {
+  basket->assetN = assetN;
+  basket->S = new real[assetN];
+  basket->V = new real[assetN];
+  basket->Weight = new real[assetN];
+  basket->Correlation = new real[assetN * assetN]();
+  basket->Cholesky = new real[assetN * assetN]();
+}
+
+void closeBasket(TBasket *basket) {
+  delete[] basket->S;
+  delete[] basket->V;
+  delete[] basket->Weight;
+  delete[] basket->Correlation;
+  delete[] basket->Cholesky;
+}
+
+int factorBaskets(TBasket *baskets, int basketN) {
+  std::vector<double> L;
+
+  for (int k = 0; k < basketN; k++) {
+    const int n = baskets[k].assetN;
+    const real *C = baskets[k].Correlation;
+    L.assign((size_t)n * n, 0.0);
+
+    // Cholesky-Banachiewicz, row by row, in double
+    for (int i = 0; i < n; i++) {
+      for (int j = 0; j <= i; j++) {
+        double sum = C[i * n + j];
+        for (int p = 0; p < j; p++) sum -= L[i * n + p] * L[j * n + p];
+
+        if (i == j) {
+          if (sum <= 0) return k;
+          L[i * n + i] = sqrt(sum);
+        } else {
+          L[i * n + j] = sum / L[j * n + j];
+        }
+      }
+    }
+
+    for (int i = 0; i < n * n; i++) baskets[k].Cholesky[i] = (real)L[i];
+  }
+
+  return -1;
+}
+
+void simulateBasketTile(const TBatchPlan &batch, int option,
+                        uint64_t sampleFirst, int tileN, real sign,
+                        real *payoff, real *control, real *adjoint) {
+  const TOptionBatch &options = *batch.options;
+  const TBasket &basket = options.baskets[options.Basket[option]];
+  const int n = basket.assetN;
+  const real X = options.X[option];
+  const double T = options.T[option];
+  const double R = options.R[option];
+  const real *L = basket.Cholesky;
+
+  // Independent normals, one row of tileN (plus alignment room) per asset
+  const int stride = PATH_TILE_N + 8;
+  thread_local std::vector<float> buffer;
+  buffer.resize((size_t)n * stride);
+  const float *Z[MAX_BASKET_ASSETS];
+
+  for (int a = 0; a < n; a++) {
+    float *row = buffer.data() + (size_t)a * stride;
+    if (batch.qmcReplicaN > 0) {
+      sobolNormals(row, tileN, philoxKey(batch.seed), option,
+                   (int)(sampleFirst / batch.replicaPathN), a,
+                   (uint32_t)(sampleFirst % batch.replicaPathN));
+      Z[a] = row;
+    } else {
+      Z[a] = tileNormals(row, batch, option, sampleFirst, tileN, a);
+    }
+  }
+
+  real value[PATH_TILE_N] = {};
+  real y[ROW_BLOCK][PATH_TILE_N];
+
+  // The reverse sweep needs each asset's correlated normal and terminal price
+  thread_local std::vector<real> saved;
+  if (adjoint) saved.resize((size_t)2 * n * PATH_TILE_N);
+  real *ySaved = saved.data();
+  real *stockSaved = ySaved + (size_t)n * PATH_TILE_N;
+
+  for (int a0 = 0; a0 < n; a0 += ROW_BLOCK) {
+    const int rowN = n - a0 < ROW_BLOCK ? n - a0 : ROW_BLOCK;
+
+    // Rows a0 .. a0 + rowN of Y = L Z. Each row of Z is loaded once per
+    // row block; entries of L above the diagonal are zero.
+    for (int r = 0; r < rowN; r++)
+      for (int i = 0; i < tileN; i++) y[r][i] = 0;
+    for (int b = 0; b < a0 + rowN; b++) {
+      const float *z = Z[b];
+      for (int r = 0; r < rowN; r++) {
+        const real l = L[(a0 + r) * n + b];
+        for (int i = 0; i < tileN; i++) y[r][i] += l * (real)z[i];
+      }
+    }
+
+    for (int r = 0; r < rowN; r++) {
+      const int a = a0 + r;
+      const real mu = (real)((R - 0.5 * basket.V[a] * basket.V[a]) * T);
+      const real sigma = sign * (real)(basket.V[a] * sqrt(T));
+      const real S0 = basket.S[a];
+      const real w = basket.Weight[a];
+
+      if (!adjoint) {
+        for (int i = 0; i < tileN; i++)
+          value[i] += w * (S0 * std::exp(mu + sigma * y[r][i]));
+        continue;
+      }
+
+      real *yRow = ySaved + (size_t)a * PATH_TILE_N;
+      real *stock = stockSaved + (size_t)a * PATH_TILE_N;
+      for (int i = 0; i < tileN; i++) {
+        yRow[i] = y[r][i];
+        stock[i] = S0 * std::exp(mu + sigma * y[r][i]);
+        value[i] += w * stock[i];
+      }
+    }
+  }
+
+  for (int i = 0; i < tileN; i++) {
+    payoff[i] = value[i] > X ? value[i] - X : 0;
+    control[i] = value[i];
+  }
+
+  if (!adjoint) return;
+
+  // Reverse sweep. The payoff's adjoint is 1 in the money; asset a's log
+  // price mu + sigma y_a then has adjoint w_a S_a(T), which flows to S_a
+  // (divided by S_a), to V_a (times sign sqrt(T) y_a - V_a T) and to y_a
+  // (times sigma), and from y_a = sum_b L_ab z_b to L_ab (times z_b).
+  const real sqrtT = (real)sqrt(T);
+  real *sBar = adjoint;
+  real *vBar = adjoint + n;
+  real *lBar = adjoint + 2 * n;
+  real itm[PATH_TILE_N], logBar[PATH_TILE_N], vTerm[PATH_TILE_N];
+  real yBar[PATH_TILE_N];
+
+  for (int i = 0; i < tileN; i++) itm[i] = value[i] > X ? 1 : 0;
+
+  for (int a = 0; a < n; a++) {
+    const real VT = (real)(basket.V[a] * T);
+    const real sigma = sign * (real)(basket.V[a] * sqrt(T));
+    const real w = basket.Weight[a];
+    const real *yRow = ySaved + (size_t)a * PATH_TILE_N;
+    const real *stock = stockSaved + (size_t)a * PATH_TILE_N;
+
+    for (int i = 0; i < tileN; i++) {
+      logBar[i] = itm[i] * w * stock[i];
+      vTerm[i] = sign * sqrtT * yRow[i] - VT;
+      yBar[i] = logBar[i] * sigma;
+    }
+
+    real *lRow = lBar + a * (a + 1) / 2;
+    sBar[a] += tileSum(logBar, tileN) / basket.S[a];
+    vBar[a] += tileDot(logBar, vTerm, tileN);
+    for (int b = 0; b <= a; b++) lRow[b] += tileDot(yBar, Z[b], tileN);
+  }
+}
+
+void basketGradient(const TBasket &basket, const double *adjoint,
+                    real *gradient) {
+  const int n = basket.assetN;
+  const real *L = basket.Cholesky;
+  std::vector<double> lBar((size_t)n * n, 0.0);
+
+  for (int a = 0; a < n; a++) {
+    gradient[a] = (real)adjoint[a];
+    gradient[n + a] = (real)adjoint[n + a];
+    for (int b = 0; b <= a; b++)
+      lBar[a * n + b] = adjoint[2 * n + a * (a + 1) / 2 + b];
+  }
+
+  // The Cholesky-Banachiewicz loops of factorBaskets() in reverse order: an
+  // entry's adjoint is complete once every entry computed after it is done.
+  // Only the lower triangle of Correlation is read, so its adjoint is the
+  // derivative for a symmetric change.
+  for (int i = n - 1; i >= 0; i--) {
+    for (int j = i; j >= 0; j--) {
+      double sumBar;
+
+      if (i == j) {
+        sumBar = lBar[i * n + i] / (2.0 * L[i * n + i]);
+      } else {
+        sumBar = lBar[i * n + j] / L[j * n + j];
+        lBar[j * n + j] -= lBar[i * n + j] * L[i * n + j] / L[j * n + j];
+        gradient[2 * n + i * (i - 1) / 2 + j] = (real)sumBar;
+      }
+
+      for (int p = 0; p < j; p++) {
+        lBar[i * n + p] -= sumBar * L[j * n + p];
+        lBar[j * n + p] -= sumBar * L[i * n + p];
+      }
+    }
+  }
+}
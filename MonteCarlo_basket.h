@@ -0,0 +1,60 @@
+#ifndef MONTECARLO_BASKET_H
+#define MONTECARLO_BASKET_H
+
+#include <cstdint>
+
+#include "MonteCarlo_common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Correlated multi-asset baskets. Asset a of a path draws its independent
+// normal from Philox stream a (or Sobol dimension a); a tile of paths is then
+// correlated with the basket's Cholesky factor, Y = L Z, as a blocked
+// lower-triangular matrix times an assets x tile matrix whose inner loop
+// runs over contiguous paths.
+////////////////////////////////////////////////////////////////////////////////
+void initBasket(TBasket *basket, int assetN);
+void closeBasket(TBasket *basket);
+
+// Cholesky-factor the correlation matrices of a batch of baskets. Returns
+// the index of the first basket whose matrix is not positive definite, or -1.
+int factorBaskets(TBasket *baskets, int basketN);
+
+////////////////////////////////////////////////////////////////////////////////
+// Adjoint sensitivities. The reverse sweep of a tile runs the forward
+// computation backwards, payoff -> basket value -> asset prices -> Y = L Z,
+// and sums per path the adjoints of every asset's spot and volatility and of
+// every entry of the Cholesky factor. L depends on the correlations alone,
+// so the sums of L's adjoints are pulled back through the factorisation once
+// per option, not once per path. The cost is a small multiple of pricing
+// whatever the number of inputs.
+////////////////////////////////////////////////////////////////////////////////
+
+// Adjoint sums per path block: d/dS_a at a, d/dV_a at assetN + a and
+// d/dL_ab (b <= a) at 2 assetN + a (a + 1) / 2 + b
+inline int basketAdjointN(int assetN) {
+  return 2 * assetN + assetN * (assetN + 1) / 2;
+}
+
+// Gradient of a basket option: d/dS_a at a, d/dV_a at assetN + a and
+// d/dCorrelation_ab (b < a, both triangles moving together) at
+// 2 assetN + a (a - 1) / 2 + b
+inline int basketGradientN(int assetN) {
+  return 2 * assetN + assetN * (assetN - 1) / 2;
+}
+
+// Terminal basket values of tileN paths of a basket option (see
+// simulatePathTile): writes the payoff and, as the control sample, the
+// basket value itself, whose mean is known in closed form. Unless adjoint is
+// NULL, the tile's sums of the undiscounted payoff's adjoints are added to
+// its basketAdjointN entries.
+void simulateBasketTile(const TBatchPlan &batch, int option,
+                        uint64_t sampleFirst, int tileN, real sign,
+                        real *payoff, real *control, real *adjoint);
+
+// Turn the mean adjoint sums of one option into its gradient: the spot and
+// volatility entries are copied, and the Cholesky factor's adjoint is
+// propagated back through the factorisation to the correlations
+void basketGradient(const TBasket &basket, const double *adjoint,
+                    real *gradient);
+
+#endif
@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+// Brownian-bridge construction order and weights (after Jaeckel, "Monte Carlo
+// Methods in Finance", ch. 10)
+////////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+#include <vector>
+
+#include "MonteCarlo_bridge.h"
+
+void initBrownianBridge(TBrownianBridge *bridge, int stepN) {
+  const int M = stepN;
+  std::vector<double> t(M);
+  std::vector<bool> filled(M, false);
+
+  for (int k = 0; k < M; k++) t[k] = (double)(k + 1) / M;
+
+  bridge->stepN = M;
+  bridge->bridgeIndex = new int[M];
+  bridge->leftIndex = new int[M];
+  bridge->rightIndex = new int[M];
+  bridge->leftWeight = new real[M];
+  bridge->rightWeight = new real[M];
+  bridge->stdDev = new real[M];
+
+  // The first normal goes straight to the terminal point
+  filled[M - 1] = true;
+  bridge->bridgeIndex[0] = M - 1;
+  bridge->leftIndex[0] = bridge->rightIndex[0] = 0;
+  bridge->leftWeight[0] = bridge->rightWeight[0] = 0;
+  bridge->stdDev[0] = (real)sqrt(t[M - 1]);
+
+  for (int i = 1, j = 0; i < M; i++) {
+    // Next unfilled stretch [j, k) and its midpoint l
+    while (filled[j]) j++;
+    int k = j;
+    while (!filled[k]) k++;
+    int l = j + ((k - 1 - j) >> 1);
+    filled[l] = true;
+
+    const double tLeft = j ? t[j - 1] : 0.0;
+    bridge->bridgeIndex[i] = l;
+    bridge->leftIndex[i] = j;
+    bridge->rightIndex[i] = k;
+    bridge->leftWeight[i] = (real)((t[k] - t[l]) / (t[k] - tLeft));
+    bridge->rightWeight[i] = (real)((t[l] - tLeft) / (t[k] - tLeft));
+    bridge->stdDev[i] =
+        (real)sqrt((t[l] - tLeft) * (t[k] - t[l]) / (t[k] - tLeft));
+
+    j = k + 1;
+    if (j >= M) j = 0;
+  }
+}
+
+void closeBrownianBridge(TBrownianBridge *bridge) {
+  delete[] bridge->bridgeIndex;
+  delete[] bridge->leftIndex;
+  delete[] bridge->rightIndex;
+  delete[] bridge->leftWeight;
+  delete[] bridge->rightWeight;
+  delete[] bridge->stdDev;
+}
+
+void buildBrownianPath(const TBrownianBridge &bridge, const float *z,
+                       real *W) {
+  W[bridge.stepN - 1] = bridge.stdDev[0] * (real)z[0];
+
+  for (int i = 1; i < bridge.stepN; i++) {
+    const int j = bridge.leftIndex[i];
+    const int k = bridge.rightIndex[i];
+    const int l = bridge.bridgeIndex[i];
+    real left = j ? bridge.leftWeight[i] * W[j - 1] : 0;
+    W[l] = left + bridge.rightWeight[i] * W[k] + bridge.stdDev[i] * (real)z[i];
+  }
+}
@@ -0,0 +1,33 @@
+#ifndef MONTECARLO_BRIDGE_H
+#define MONTECARLO_BRIDGE_H
+
+#include "realtype.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Brownian-bridge path construction on a uniform grid t_k = (k + 1) / stepN
+// of unit length. The first normal fixes the terminal value, the next ones
+// the midpoints of successively finer intervals, so the leading (best
+// distributed) quasi-random dimensions carry most of the path variance.
+// Scale the result by sqrt(T) for an option of maturity T.
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  int stepN;
+  // Grid point filled by the i-th normal and its already filled neighbours;
+  // leftIndex == 0 means the left neighbour is W(0) = 0, otherwise it is
+  // grid point leftIndex - 1
+  int *bridgeIndex;
+  int *leftIndex;
+  int *rightIndex;
+  real *leftWeight;
+  real *rightWeight;
+  real *stdDev;
+} TBrownianBridge;
+
+void initBrownianBridge(TBrownianBridge *bridge, int stepN);
+void closeBrownianBridge(TBrownianBridge *bridge);
+
+// W[k] = W(t_k) for k = 0 .. stepN - 1, from stepN N(0,1) samples z
+void buildBrownianPath(const TBrownianBridge &bridge, const float *z,
+                       real *W);
+
+#endif
@@ -0,0 +1,360 @@
+#ifndef MONTECARLO_COMMON_H
+#define MONTECARLO_COMMON_H
+
+#include <cstdint>
+
+#include "MonteCarlo_bridge.h"
+#include "MonteCarlo_precision.h"
+#include "realtype.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Global types
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  real S;
+  real X;
+  real T;
+  real R;
+  real V;
+} TOptionData;
+
+// Sensitivities of the option value to the spot, volatility and rate
+enum { GREEK_DELTA, GREEK_VEGA, GREEK_RHO, GREEK_N };
+
+typedef struct {
+  real Expected;
+  real Confidence;
+  // Greeks and their confidence widths, estimated from the same paths as
+  // Expected; zero unless the batch computes Greeks
+  real Greek[GREEK_N];
+  real GreekConfidence[GREEK_N];
+} TOptionValue;
+
+// Payoffs priced by the path engine. Path-dependent payoffs are monitored at
+// the stepN points of the batch's time grid (and at inception).
+typedef enum {
+  // max(S(T) - X, 0)
+  PAYOFF_CALL = 0,
+  // Fixed-strike lookback call: max(max_t S(t) - X, 0)
+  PAYOFF_LOOKBACK_CALL,
+  // Asian calls on the arithmetic or geometric mean of S(t_1) .. S(t_stepN):
+  // max(A - X, 0)
+  PAYOFF_ASIAN_CALL,
+  PAYOFF_GEOMETRIC_ASIAN_CALL,
+  // Calls knocked out or in when S(t) crosses the barrier from above (down)
+  // or below (up). The barrier is monitored continuously: between steps the
+  // Brownian-bridge crossing probability is applied to each path.
+  PAYOFF_DOWN_OUT_CALL,
+  PAYOFF_DOWN_IN_CALL,
+  PAYOFF_UP_OUT_CALL,
+  PAYOFF_UP_IN_CALL,
+  // Put exercisable at every step date: max(X - S(t), 0), priced by
+  // Longstaff-Schwartz regression (MonteCarlo_american.h)
+  PAYOFF_AMERICAN_PUT,
+  // Call on a weighted basket of correlated assets at maturity:
+  // max(sum_a w_a S_a(T) - X, 0) (MonteCarlo_basket.h)
+  PAYOFF_BASKET_CALL,
+  // Cash-or-nothing call paying 1 if S(T) > X
+  PAYOFF_DIGITAL_CALL,
+} TPayoffType;
+
+// Dynamics of an option's underlying. GBM has the constant volatility V of
+// TOptionData; other models take their parameters from the batch's model
+// tables and give V the meaning stated there.
+typedef enum {
+  MODEL_GBM = 0,
+  // Heston stochastic variance (MonteCarlo_heston.h)
+  MODEL_HESTON,
+  // Local volatility sigma(t, S) from a gridded surface
+  // (MonteCarlo_localvol.h); V is unused
+  MODEL_LOCAL_VOL,
+  // Merton jump-diffusion (MonteCarlo_merton.h)
+  MODEL_MERTON,
+} TModelType;
+
+// Heston model: dv = kappa (theta - v) dt + xi sqrt(v) dW_v with
+// d<W_S, W_v> = rho dt. The option's V is the initial volatility sqrt(v(0)).
+typedef struct {
+  real kappa;
+  real theta;
+  real xi;
+  real rho;
+} THeston;
+
+// Merton jump-diffusion: GBM with volatility V between jumps, which arrive
+// at rate lambda and multiply the price by J, log J ~ N(muJ, deltaJ^2). The
+// drift is compensated, so the discounted price stays a martingale.
+typedef struct {
+  real lambda;
+  real muJ;
+  real deltaJ;
+} TMerton;
+
+// Local volatility surface on a uniform grid of timeN times from 0 and spotN
+// log-moneyness nodes x = log(S / spot) from xFirst. Cell (j, i) holds the
+// bilinear interpolant sigma = c0 + c1 x + c2 t + c3 x t in global
+// coordinates. Time row j stores the c0, c1, c2 and c3 of its cells as four
+// arrays of rowStride entries, a whole number of 64-byte cache lines, so
+// every row and array starts on a line. sigma is flat beyond the grid.
+const int MAX_LOCALVOL_SPOT_N = 128;
+
+typedef struct {
+  int timeN, spotN;
+  int rowStride;
+  real spot;
+  real dt, xFirst, dx;
+  real *coefficients;
+} TLocalVol;
+
+// Basket of up to MAX_BASKET_ASSETS correlated lognormal assets. Matrices
+// are assetN x assetN, row-major; Cholesky holds the lower-triangular factor
+// of Correlation once factorBaskets() has run.
+const int MAX_BASKET_ASSETS = 64;
+
+typedef struct {
+  int assetN;
+  real *S;
+  real *V;
+  real *Weight;
+  real *Correlation;
+  real *Cholesky;
+} TBasket;
+
+// Structure-of-arrays copy of an option batch. Columns are 64-byte aligned
+// and padded to OPTION_LANES entries so kernels load per-option terms with
+// plain vector loads; the drift, volatility and discount terms every path
+// needs are computed once, in double precision, on conversion.
+const int OPTION_LANES = 16;
+
+typedef struct {
+  int optionN;
+  real *S;
+  real *X;
+  real *T;
+  real *R;
+  real *V;
+  // (R - V^2 / 2) * T
+  real *MuByT;
+  // V * sqrt(T)
+  real *VBySqrtT;
+  // exp(-R * T)
+  real *DiscountRT;
+  // Target Confidence width for adaptive runs; 0 runs the full path budget
+  real *Tolerance;
+  // Payoff of each option; PAYOFF_CALL on conversion
+  int *Payoff;
+  // Barrier level of barrier payoffs
+  real *Barrier;
+  // Index into baskets of basket payoffs; their S and V columns are unused
+  int *Basket;
+  const TBasket *baskets;
+  // Model of each option; MODEL_GBM on conversion. Heston and Merton
+  // options take their parameters from heston and merton, indexed by option,
+  // and local volatility options the surface at index Surface into surfaces,
+  // which many options may share.
+  int *Model;
+  const THeston *heston;
+  const TMerton *merton;
+  int *Surface;
+  const TLocalVol *surfaces;
+} TOptionBatch;
+
+// Paths per reduction leaf. Path blocks are aligned to the option's global
+// path index, so their partial sums do not depend on the chunk size.
+const int PATH_BLOCK_N = 4096;
+
+// Sample streams whose moments a path block keeps: the payoff, the centred
+// control variate and the Greeks
+enum { MOMENT_PAYOFF, MOMENT_CONTROL, MOMENT_GREEK,
+       MOMENT_N = MOMENT_GREEK + GREEK_N };
+
+// Moments of the samples of a path block, or of any union of blocks: their
+// count, each stream's mean and M2 (sum of squared deviations from the mean),
+// the co-moment of payoff and control (sum of products of their deviations)
+// and, for antithetic pairs, the spread sum (y_up - y_down)^2 / 2 that turns
+// the pairs' M2 into that of the individual paths. Unlike sums of squares,
+// these lose no digits to large means.
+typedef struct {
+  double n;
+  double mean[MOMENT_N];
+  double m2[MOMENT_N];
+  double coPayoffControl;
+  double pairSpread;
+} TBlockMoments;
+
+// Moments of the union of two disjoint sample sets (Chan, Golub and LeVeque's
+// parallel update). Exact in real arithmetic for any grouping, so blocks, chunks and devices merge
+// in any order; treeSum() applies it in a fixed shape for bitwise
+// reproducibility.
+inline TBlockMoments operator+(const TBlockMoments &a, const TBlockMoments &b) {
+  if (a.n == 0) return b;
+  if (b.n == 0) return a;
+
+  TBlockMoments c;
+  c.n = a.n + b.n;
+  const double weight = a.n * b.n / c.n;
+  double delta[MOMENT_N];
+
+  for (int s = 0; s < MOMENT_N; s++) {
+    delta[s] = b.mean[s] - a.mean[s];
+    c.mean[s] = a.mean[s] + delta[s] * (b.n / c.n);
+    c.m2[s] = a.m2[s] + b.m2[s] + delta[s] * delta[s] * weight;
+  }
+  c.coPayoffControl = a.coPayoffControl + b.coPayoffControl +
+                      delta[MOMENT_PAYOFF] * delta[MOMENT_CONTROL] * weight;
+  c.pairSpread = a.pairSpread + b.pairSpread;
+  return c;
+}
+
+// Emulated device: a contiguous group of host cores
+typedef struct {
+  int id;
+  int coreFirst;
+  int coreCount;
+} TDeviceInfo;
+
+class TaskScheduler;
+
+// State shared by all plans of a batch
+typedef struct {
+  // Whole option batch and its results
+  TOptionBatch *options;
+  TOptionValue *callValue;
+  int optionN;
+  // Gradients of basket options when the batch computes Greeks,
+  // gradientN >= basketGradientN(assetN) entries per option
+  // (MonteCarlo_basket.h); NULL otherwise
+  real *gradient;
+  int gradientN;
+  // Paths per option, split into chunkN scheduled chunks of chunkPathN paths.
+  // chunkPathN is rounded up to a whole number of path blocks.
+  int pathN;
+  int chunkPathN;
+  int chunkN;
+  // Chunks added per option and round; options whose Confidence drops below
+  // their tolerance are not scheduled for further rounds
+  int roundChunkN;
+  // Per-option count of paths scheduled so far
+  int *h_PathN;
+  // Time steps per path. One-step European calls take a direct terminal
+  // value fast path; everything else runs through the path engine.
+  int stepN;
+  // Brownian-bridge order for quasi-random multi-step paths
+  TBrownianBridge bridge;
+  // Price paths in antithetic pairs (z, -z); pathN is rounded up to even
+  bool antithetic;
+  // Use the discounted terminal stock price, whose mean S is known in closed
+  // form, as a control variate with an estimated optimal coefficient.
+  // Arithmetic Asians use the geometric Asian payoff on the same path
+  // instead. h_ControlMean holds the per-option undiscounted control mean.
+  bool controlVariate;
+  real *h_ControlMean;
+  // Randomised quasi-Monte Carlo: when qmcReplicaN > 0 each option runs
+  // qmcReplicaN independently digit-shifted Sobol replicas of replicaPathN
+  // paths, and Confidence comes from the spread of the replica means.
+  // pathN is rounded up to qmcReplicaN whole replicas of whole path blocks.
+  int qmcReplicaN;
+  int replicaPathN;
+  // Arithmetic of one-step European calls (MonteCarlo_precision.h)
+  TPrecision precision;
+  // Per-(option, path block) moments of the sample units, kept in double
+  // whatever the policy so that no policy is capped by them. In antithetic
+  // mode the sample unit is the pair average. The control and Greek streams
+  // are zero unless the batch uses them.
+  int blockN;
+  TBlockMoments *h_BlockMoments;
+  // Estimate Greeks alongside the price: pathwise derivatives, or
+  // likelihood-ratio weights for discontinuous payoffs, accumulated per path
+  // block like the payoff (not available for American options). Basket
+  // options get their full gradient instead, by adjoint differentiation:
+  // h_BlockSumAdjoint holds adjointN adjoint sums per (option, path block).
+  bool greeks;
+  int adjointN;
+  real *h_BlockSumAdjoint;
+  // Multilevel Monte Carlo (MonteCarlo_mlmc.h): when levelN > 0 each option
+  // has up to levelN levels, and row levelRow(option, level) takes the
+  // option's place in h_BlockMoments, with blockN blocks per row. The sample
+  // unit is the fine minus the coarse payoff; the control stream holds the
+  // fine payoff. h_LevelN counts each option's active levels and
+  // h_LevelPathN the paths scheduled per row, a whole number of path tiles.
+  int levelN;
+  int *h_LevelN;
+  int *h_LevelPathN;
+  // Per-option variance reduction over plain sampling; 0 when the achieved
+  // variance is zero or too small for the run to resolve. Multilevel runs
+  // report the cost reduction over single-level sampling on the finest
+  // level's grid instead.
+  real *h_VarianceRatio;
+  // Seed shared by all plans of a batch
+  uint64_t seed;
+  // Per-device task deques
+  TaskScheduler *scheduler;
+} TBatchPlan;
+
+typedef struct {
+  // Emulated device this plan is pinned to
+  TDeviceInfo device;
+  // Home slice of the batch: option count and index of the first option
+  int optionCount;
+  int optionFirst;
+  // Host-side data source and result destination
+  TOptionData *optionData;
+  TOptionValue *callValue;
+  // Batch this plan belongs to
+  TBatchPlan *batch;
+  // Work done by this device, including tasks stolen from other devices
+  int tasksDone;
+  int tasksStolen;
+  long long pathsDone;
+  // Time stamp
+  float time;
+} TOptionPlan;
+
+////////////////////////////////////////////////////////////////////////////////
+// Option batch layout (MonteCarlo_options.cpp)
+////////////////////////////////////////////////////////////////////////////////
+void initOptionBatch(TOptionBatch *batch, const TOptionData *optionData,
+                     int optionN);
+void closeOptionBatch(TOptionBatch *batch);
+
+////////////////////////////////////////////////////////////////////////////////
+// Device emulation (MonteCarlo_device.cpp)
+////////////////////////////////////////////////////////////////////////////////
+int getHostCoreCount();
+void partitionDevices(TDeviceInfo *devices, int deviceN, int coreN);
+void bindThreadToCore(int core);
+
+////////////////////////////////////////////////////////////////////////////////
+// Device-side pricing (MonteCarlo_kernel.cpp)
+////////////////////////////////////////////////////////////////////////////////
+void initMonteCarloBatch(TBatchPlan *batch, int deviceN, bool steal);
+void closeMonteCarloBatch(TBatchPlan *batch);
+void initMonteCarloDevice(TOptionPlan *plan);
+void MonteCarloDevice(TOptionPlan *plan);
+void reduceMonteCarloDevice(TOptionPlan *plan);
+int scheduleMonteCarloRound(TBatchPlan *batch, int deviceN);
+
+// Baseline of --bench-fused: price the path blocks of a one-step call option
+// from its samples z, already in memory
+void MonteCarloBufferedOption(const TBatchPlan &batch, int option,
+                              const float *z);
+
+////////////////////////////////////////////////////////////////////////////////
+// CPU reference (MonteCarlo_gold.cpp)
+////////////////////////////////////////////////////////////////////////////////
+double BlackScholesCall(const TOptionData &option);
+double LookbackCall(const TOptionData &option, int stepN);
+double GeometricAsianCall(const TOptionData &option, int stepN);
+double AsianCallLevy(const TOptionData &option, int stepN);
+double BermudanPutBinomial(const TOptionData &option, int exerciseN);
+double BasketCallLevy(const TBasket &basket, const TOptionData &option);
+double DigitalCall(const TOptionData &option);
+double HestonCall(const TOptionData &option, const THeston &heston);
+double DisplacedDiffusionCall(const TOptionData &option, double floor);
+double MertonCall(const TOptionData &option, const TMerton &merton);
+double BarrierCall(const TOptionData &option, double barrier, bool up,
+                   bool knockIn);
+void MonteCarloCPU(TOptionValue &callValue, const TOptionData &option,
+                   double *h_Samples, int pathN);
+
+#endif
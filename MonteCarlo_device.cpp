@@ -0,0 +1,47 @@
+////////////////////////////////////////////////////////////////////////////////
+// Emulated devices: each device owns a contiguous group of host cores and
+// runs its worker threads pinned to that group.
+////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <thread>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "MonteCarlo_common.h"
+
+int getHostCoreCount() {
+  int coreN = (int)std::thread::hardware_concurrency();
+  return coreN > 0 ? coreN : 1;
+}
+
+// Split coreN host cores into deviceN contiguous groups. Leftover cores go to
+// the first devices; when there are more devices than cores, devices share
+// cores round-robin.
+void partitionDevices(TDeviceInfo *devices, int deviceN, int coreN) {
+  int coreFirst = 0;
+
+  for (int i = 0; i < deviceN; i++) {
+    int coreCount = coreN / deviceN;
+    if (i < coreN % deviceN) coreCount++;
+    coreCount = std::max(coreCount, 1);
+
+    devices[i].id = i;
+    devices[i].coreFirst = coreFirst % coreN;
+    devices[i].coreCount = coreCount;
+    coreFirst += coreCount;
+  }
+}
+
+void bindThreadToCore(int core) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(core % getHostCoreCount(), &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#else
+  (void)core;
+#endif
+}
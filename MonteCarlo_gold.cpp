@@ -0,0 +1,414 @@
+////////////////////////////////////////////////////////////////////////////////
+// CPU reference: closed-form Black-Scholes and a double-precision Monte Carlo
+////////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+#include <complex>
+#include <vector>
+
+#include "MonteCarlo_common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Polynomial approximation of the cumulative normal distribution function
+////////////////////////////////////////////////////////////////////////////////
+static double CND(double d) {
+  const double A1 = 0.31938153;
+  const double A2 = -0.356563782;
+  const double A3 = 1.781477937;
+  const double A4 = -1.821255978;
+  const double A5 = 1.330274429;
+  const double RSQRT2PI = 0.39894228040143267793994605993438;
+
+  double K = 1.0 / (1.0 + 0.2316419 * fabs(d));
+
+  double cnd = RSQRT2PI * exp(-0.5 * d * d) *
+               (K * (A1 + K * (A2 + K * (A3 + K * (A4 + K * A5)))));
+
+  if (d > 0) cnd = 1.0 - cnd;
+
+  return cnd;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Black-Scholes formula for a European call
+////////////////////////////////////////////////////////////////////////////////
+double BlackScholesCall(const TOptionData &option) {
+  double S = option.S;
+  double X = option.X;
+  double T = option.T;
+  double R = option.R;
+  double V = option.V;
+
+  double sqrtT = sqrt(T);
+  double d1 = (log(S / X) + (R + 0.5 * V * V) * T) / (V * sqrtT);
+  double d2 = d1 - V * sqrtT;
+  double CNDD1 = CND(d1);
+  double CNDD2 = CND(d2);
+
+  double expRT = exp(-R * T);
+  return S * CNDD1 - X * expRT * CNDD2;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Fixed-strike lookback call on the maximum of stepN equally spaced prices
+// and the spot. Continuous monitoring is priced in closed form (Conze and
+// Viswanathan); discrete monitoring uses the Broadie-Glasserman-Kou shift
+// of the continuous maximum by exp(-0.5826 * V * sqrt(T / stepN)). stepN = 0
+// selects continuous monitoring.
+////////////////////////////////////////////////////////////////////////////////
+static double lookbackAboveSpot(double S, double K, double T, double R,
+                                double V) {
+  // Continuous lookback call with strike K >= S, the running maximum
+  // starting at S
+  double sqrtT = sqrt(T);
+  double d1 = (log(S / K) + (R + 0.5 * V * V) * T) / (V * sqrtT);
+  double d2 = d1 - V * sqrtT;
+  double expRT = exp(-R * T);
+  double ratio = 0.5 * V * V / R;
+
+  return S * CND(d1) - K * expRT * CND(d2) +
+         S * expRT * ratio *
+             (-pow(S / K, -1.0 / ratio) * CND(d1 - 2.0 * R * sqrtT / V) +
+              CND(d1) / expRT);
+}
+
+double LookbackCall(const TOptionData &option, int stepN) {
+  double S = option.S;
+  double X = option.X;
+  double T = option.T;
+  double R = option.R;
+  double V = option.V;
+
+  // max(M, S) - X = max(S - X, 0) + max(M - max(X, S), 0) for the maximum M
+  // of the path after the spot
+  double shift = stepN > 0 ? 0.5826 * V * sqrt(T / stepN) : 0;
+  double K = X > S ? X : S;
+  return exp(-R * T) * (S > X ? S - X : 0) +
+         exp(-shift) * lookbackAboveSpot(S, K * exp(shift), T, R, V);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Asian calls on the average of the stepN prices S(kT / stepN), k = 1..stepN,
+// or with stepN = 0 on the continuous average over [0, T]. The geometric
+// average is lognormal, so its call has a Black-Scholes style closed form.
+// The arithmetic one is priced by Levy's approximation, a lognormal matched
+// to the first two moments of the average.
+////////////////////////////////////////////////////////////////////////////////
+double GeometricAsianCall(const TOptionData &option, int stepN) {
+  double S = option.S;
+  double X = option.X;
+  double T = option.T;
+  double R = option.R;
+  double V = option.V;
+  double M = stepN;
+
+  // Mean and variance of log G; the weights tend to 1/2 and 1/3
+  double meanWeight = stepN > 0 ? (M + 1) / (2 * M) : 0.5;
+  double varWeight = stepN > 0 ? (M + 1) * (2 * M + 1) / (6 * M * M) : 1.0 / 3;
+  double mu = log(S) + (R - 0.5 * V * V) * T * meanWeight;
+  double sigma = V * sqrt(T * varWeight);
+  double d1 = (mu - log(X) + sigma * sigma) / sigma;
+  double d2 = d1 - sigma;
+
+  return exp(-R * T) *
+         (exp(mu + 0.5 * sigma * sigma) * CND(d1) - X * CND(d2));
+}
+
+double AsianCallLevy(const TOptionData &option, int stepN) {
+  double S = option.S;
+  double X = option.X;
+  double T = option.T;
+  double R = option.R;
+  double V = option.V;
+  double dt = T / stepN;
+
+  // E[A] and E[A^2]; E[S(t_j) S(t_k)] = S^2 exp(R (t_j + t_k) + V^2 t_j)
+  // for t_j <= t_k
+  double m1 = 0, m2 = 0;
+
+  if (stepN > 0) {
+    for (int j = 1; j <= stepN; j++) {
+      m1 += exp(R * j * dt);
+      m2 += exp((2 * R + V * V) * j * dt);
+      for (int k = j + 1; k <= stepN; k++)
+        m2 += 2 * exp(R * (j + k) * dt + V * V * j * dt);
+    }
+
+    m1 *= S / stepN;
+    m2 *= S * S / ((double)stepN * stepN);
+  } else {
+    // The same sums as integrals over 0 <= t_j <= t_k <= T
+    double a = R + V * V, b = 2 * R + V * V;
+    m1 = S * (exp(R * T) - 1) / (R * T);
+    m2 = 2 * S * S / (T * T) *
+         (exp(b * T) / (a * b) + (1 / b - exp(R * T) / a) / R);
+  }
+
+  double sigma = sqrt(log(m2 / (m1 * m1)));
+  double d1 = (log(m1 / X) + 0.5 * sigma * sigma) / sigma;
+  double d2 = d1 - sigma;
+
+  return exp(-R * T) * (m1 * CND(d1) - X * CND(d2));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Continuously monitored single-barrier calls in closed form (Merton; Reiner
+// and Rubinstein). The knock-in and knock-out prices add up to the vanilla
+// call; options starting beyond the barrier are already knocked.
+////////////////////////////////////////////////////////////////////////////////
+double BarrierCall(const TOptionData &option, double barrier, bool up,
+                   bool knockIn) {
+  double S = option.S;
+  double X = option.X;
+  double T = option.T;
+  double R = option.R;
+  double V = option.V;
+  double H = barrier;
+
+  double call = BlackScholesCall(option);
+  if (up ? S >= H : S <= H) return knockIn ? call : 0;
+
+  double sqrtT = sqrt(T);
+  double VBySqrtT = V * sqrtT;
+  double expRT = exp(-R * T);
+  double lambda = (R + 0.5 * V * V) / (V * V);
+  double HS2L = pow(H / S, 2 * lambda);
+  double HS2L2 = pow(H / S, 2 * lambda - 2);
+  double y = log(H * H / (S * X)) / VBySqrtT + lambda * VBySqrtT;
+  double x1 = log(S / H) / VBySqrtT + lambda * VBySqrtT;
+  double y1 = log(H / S) / VBySqrtT + lambda * VBySqrtT;
+  double in;
+
+  if (!up && H <= X)
+    in = S * HS2L * CND(y) - X * expRT * HS2L2 * CND(y - VBySqrtT);
+  else if (!up)
+    in = call - (S * CND(x1) - X * expRT * CND(x1 - VBySqrtT) -
+                 S * HS2L * CND(y1) + X * expRT * HS2L2 * CND(y1 - VBySqrtT));
+  else if (H <= X)
+    in = call;
+  else
+    in = S * CND(x1) - X * expRT * CND(x1 - VBySqrtT) -
+         S * HS2L * (CND(-y) - CND(-y1)) +
+         X * expRT * HS2L2 * (CND(-y + VBySqrtT) - CND(-y1 + VBySqrtT));
+
+  return knockIn ? in : call - in;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Put exercisable at t_k = k T / exerciseN, k = 0..exerciseN, on a
+// Cox-Ross-Rubinstein tree whose step count is a multiple of exerciseN, so
+// the exercise dates fall on tree levels
+////////////////////////////////////////////////////////////////////////////////
+double BermudanPutBinomial(const TOptionData &option, int exerciseN) {
+  const double S = option.S;
+  const double X = option.X;
+  const double T = option.T;
+  const double R = option.R;
+  const double V = option.V;
+  const int stepsPerDate = (1000 + exerciseN - 1) / exerciseN;
+  const int N = stepsPerDate * exerciseN;
+
+  const double dt = T / N;
+  const double u = exp(V * sqrt(dt));
+  const double d = 1 / u;
+  const double p = (exp(R * dt) - d) / (u - d);
+  const double discount = exp(-R * dt);
+  std::vector<double> value(N + 1);
+
+  for (int j = 0; j <= N; j++) {
+    const double ST = S * pow(u, 2 * j - N);
+    value[j] = ST < X ? X - ST : 0;
+  }
+
+  for (int n = N - 1; n >= 0; n--) {
+    const bool exercise = n % stepsPerDate == 0;
+    for (int j = 0; j <= n; j++) {
+      value[j] = discount * (p * value[j + 1] + (1 - p) * value[j]);
+      if (exercise) {
+        const double St = S * pow(u, 2 * j - n);
+        if (X - St > value[j]) value[j] = X - St;
+      }
+    }
+  }
+
+  return value[0];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Basket call by Levy's approximation: the basket value at maturity is
+// replaced by a lognormal with its first two moments,
+// E[B] = sum_a w_a F_a and E[B^2] = sum_ab w_a w_b F_a F_b exp(rho_ab V_a V_b T)
+////////////////////////////////////////////////////////////////////////////////
+double BasketCallLevy(const TBasket &basket, const TOptionData &option) {
+  const double X = option.X;
+  const double T = option.T;
+  const double R = option.R;
+  const int n = basket.assetN;
+
+  double m1 = 0, m2 = 0;
+
+  for (int a = 0; a < n; a++) {
+    const double Fa = basket.Weight[a] * basket.S[a] * exp(R * T);
+    m1 += Fa;
+    for (int b = 0; b < n; b++) {
+      const double Fb = basket.Weight[b] * basket.S[b] * exp(R * T);
+      m2 += Fa * Fb *
+            exp((double)basket.Correlation[a * n + b] * basket.V[a] *
+                basket.V[b] * T);
+    }
+  }
+
+  double sigma = sqrt(log(m2 / (m1 * m1)));
+  double d1 = (log(m1 / X) + 0.5 * sigma * sigma) / sigma;
+  double d2 = d1 - sigma;
+
+  return exp(-R * T) * (m1 * CND(d1) - X * CND(d2));
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Cash-or-nothing call paying 1 at T if S(T) > X
+////////////////////////////////////////////////////////////////////////////////
+double DigitalCall(const TOptionData &option) {
+  double S = option.S;
+  double X = option.X;
+  double T = option.T;
+  double R = option.R;
+  double V = option.V;
+
+  double d2 = (log(S / X) + (R - 0.5 * V * V) * T) / (V * sqrt(T));
+  return exp(-R * T) * CND(d2);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Heston call by Lewis' single integral over the characteristic function phi
+// of log(S(T) / F), F = S exp(RT), taken in the "little trap" form that stays
+// on the principal branch of the logarithm (Albrecher et al.):
+// C = S - sqrt(S X) exp(-RT / 2) / pi *
+//     int_0^inf Re[exp(iuk) phi(u - i/2)] / (u^2 + 1/4) du, k = log(F / X).
+// The integral runs in unit Simpson panels until they stop contributing.
+////////////////////////////////////////////////////////////////////////////////
+static double hestonIntegrand(double u, double k, double v0, double T,
+                              const THeston &heston) {
+  typedef std::complex<double> complex;
+  const double kappa = heston.kappa, theta = heston.theta;
+  const double xi = heston.xi, rho = heston.rho;
+  const complex i(0, 1);
+  const complex w = u - 0.5 * i;
+
+  const complex beta = kappa - rho * xi * i * w;
+  const complex d = sqrt(beta * beta + xi * xi * (i * w + w * w));
+  const complex g = (beta - d) / (beta + d);
+  const complex e = exp(-d * T);
+  const complex C = kappa * theta / (xi * xi) *
+                    ((beta - d) * T - 2.0 * log((1.0 - g * e) / (1.0 - g)));
+  const complex D = (beta - d) / (xi * xi) * (1.0 - e) / (1.0 - g * e);
+
+  return exp(i * u * k + C + D * v0).real() / (u * u + 0.25);
+}
+
+double HestonCall(const TOptionData &option, const THeston &heston) {
+  double S = option.S;
+  double X = option.X;
+  double T = option.T;
+  double R = option.R;
+  double V = option.V;
+
+  const double k = log(S / X) + R * T;
+  const int panelN = 16;
+  const double h = 1.0 / panelN;
+  double integral = 0;
+
+  for (int panel = 0; panel < 4096; panel++) {
+    double sum = 0;
+    for (int j = 0; j <= panelN; j++) {
+      const double weight = j == 0 || j == panelN ? 1 : j & 1 ? 4 : 2;
+      sum += weight * hestonIntegrand(panel + j * h, k, V * V, T, heston);
+    }
+    sum *= h / 3;
+    integral += sum;
+    if (panel >= 8 && fabs(sum) < 1e-14 * fabs(integral)) break;
+  }
+
+  return S - sqrt(S * X) * exp(-0.5 * R * T) / M_PI * integral;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Call under the displaced diffusion S(t) = Y(t) + floor exp(Rt), Y lognormal
+// with volatility V: local volatility sigma(t, S) = V (1 - floor exp(Rt) / S).
+// A call on S is a Black-Scholes call on Y struck at X - floor exp(RT); a
+// strike at or below zero leaves the forward Y(0) - that strike exp(-RT).
+////////////////////////////////////////////////////////////////////////////////
+double DisplacedDiffusionCall(const TOptionData &option, double floor) {
+  TOptionData shifted = option;
+  const double X = option.X - floor * exp(option.R * option.T);
+
+  shifted.S = (real)(option.S - floor);
+  shifted.X = (real)X;
+  if (X <= 0) return shifted.S - X * exp(-option.R * option.T);
+  return BlackScholesCall(shifted);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Merton jump-diffusion call as Merton's series over the jump count n of
+// Black-Scholes calls with rate R - lambda kbar + n log(1 + kbar) / T and
+// variance V^2 + n deltaJ^2 / T, weighted by Poisson(lambda (1 + kbar) T)
+////////////////////////////////////////////////////////////////////////////////
+double MertonCall(const TOptionData &option, const TMerton &merton) {
+  double T = option.T;
+  double R = option.R;
+  double V = option.V;
+
+  const double kbar =
+      exp(merton.muJ + 0.5 * merton.deltaJ * merton.deltaJ) - 1;
+  const double m = merton.lambda * (1 + kbar) * T;
+  double weight = exp(-m), sum = 0;
+
+  for (int n = 0; n < 1000; n++) {
+    TOptionData term = option;
+    term.R = (real)(R - merton.lambda * kbar + n * log(1 + kbar) / T);
+    term.V = (real)sqrt(V * V + n * merton.deltaJ * merton.deltaJ / T);
+    sum += weight * BlackScholesCall(term);
+    if (n > m && weight < 1e-16) break;
+    weight *= m / (n + 1);
+  }
+
+  return sum;
+}
+
+static double endCallValue(double S, double X, double r, double MuByT,
+                           double VBySqrtT) {
+  double callValue = S * exp(MuByT + VBySqrtT * r) - X;
+  return (callValue > 0) ? callValue : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Monte Carlo over caller-supplied N(0,1) samples, accumulated in double
+////////////////////////////////////////////////////////////////////////////////
+void MonteCarloCPU(TOptionValue &callValue, const TOptionData &option,
+                   double *h_Samples, int pathN) {
+  const double S = option.S;
+  const double X = option.X;
+  const double T = option.T;
+  const double R = option.R;
+  const double V = option.V;
+  const double MuByT = (R - 0.5 * V * V) * T;
+  const double VBySqrtT = V * sqrt(T);
+
+  double sum = 0, sum2 = 0;
+
+  for (int pos = 0; pos < pathN; pos++) {
+    double sample = h_Samples[pos];
+    double callValue = endCallValue(S, X, sample, MuByT, VBySqrtT);
+    sum += callValue;
+    sum2 += callValue * callValue;
+  }
+
+  // Derive average from the total sum and discount by riskfree rate
+  callValue.Expected = (real)(exp(-R * T) * sum / (double)pathN);
+  // Standard deviation
+  double stdDev = sqrt(((double)pathN * sum2 - sum * sum) /
+                       ((double)pathN * (double)(pathN - 1)));
+  // Confidence width; in 95% of all cases theoretical value lies within these
+  // borders
+  callValue.Confidence =
+      (real)(exp(-R * T) * 1.96 * stdDev / sqrt((double)pathN));
+}
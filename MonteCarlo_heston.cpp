@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+// Heston quadratic-exponential step
+////////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+
+#include "MonteCarlo_heston.h"
+
+// Switching point between the quadratic and exponential variance schemes
+static const real PSI_C = (real)1.5;
+
+void initHestonStep(THestonStep *step, const THeston &heston, double R,
+                    double dt) {
+  const double kappa = heston.kappa, theta = heston.theta;
+  const double xi = heston.xi, rho = heston.rho;
+  const double E = exp(-kappa * dt);
+  const double drift = kappa * rho / xi - 0.5;
+
+  step->expKappaDt = (real)E;
+  step->theta = (real)theta;
+  step->varV = (real)(xi * xi * E * (1 - E) / kappa);
+  step->varTheta = (real)(theta * xi * xi * (1 - E) * (1 - E) / (2 * kappa));
+  step->RDt = (real)(R * dt);
+  step->K1 = (real)(0.5 * dt * drift - rho / xi);
+  step->K2 = (real)(0.5 * dt * drift + rho / xi);
+  step->K3 = (real)(0.5 * dt * (1 - rho * rho));
+  step->K4 = step->K3;
+}
+
+void hestonStep(const THestonStep &step, real *x, real *v, const float *zS,
+                const float *zV, real sign, int tileN) {
+  // exp(A v') is the part of exp(x') driven by the new variance
+  const real A = step.K2 + step.K4 / 2;
+
+  for (int i = 0; i < tileN; i++) {
+    const real v0 = v[i];
+    const real z = sign * (real)zV[i];
+    const real m = step.theta + (v0 - step.theta) * step.expKappaDt;
+    const real s2 = v0 * step.varV + step.varTheta;
+    const real psi = s2 / (m * m);
+    const bool quadratic = psi <= PSI_C;
+
+    // Quadratic: v' = a (b + Z)^2, E[exp(A v')] = exp(A b^2 a / (1 - 2 A a))
+    // / sqrt(1 - 2 A a)
+    const real twoByPsi = 2 / psi;
+    const real b2 =
+        twoByPsi - 1 +
+        std::sqrt(std::fmax(twoByPsi * (twoByPsi - 1), (real)0));
+    const real a = m / (1 + b2);
+    const real bz = std::sqrt(b2) + z;
+    const real vQuadratic = a * bz * bz;
+    const real q = 1 - 2 * A * a;
+
+    // Exponential: v' = 0 with probability p, else Exp(beta); inverted on
+    // the upper tail 1 - U = Phi(-Z), which float resolves where U does not.
+    // E[exp(A v')] = p + beta (1 - p) / (beta - A)
+    const real p = (psi - 1) / (psi + 1);
+    const real beta = (1 - p) / m;
+    const real tail = (real)0.5 * std::erfc(z * (real)M_SQRT1_2);
+    const real logTail = std::log((1 - p) / tail);
+    const real vExponential = tail >= 1 - p ? 0 : logTail / beta;
+    const real mExponential = p + beta * (1 - p) / (beta - A);
+
+    // K0* = -log E[exp(A v')] - (K1 + K3 / 2) v, one logarithm for either
+    // scheme
+    const real v1 = quadratic ? vQuadratic : vExponential;
+    const real logM = (quadratic ? A * b2 * a / q : 0) +
+                      (quadratic ? (real)-0.5 : 1) *
+                          std::log(quadratic ? q : mExponential);
+    const real K0 = -logM - (step.K1 + step.K3 / 2) * v0;
+    x[i] += step.RDt + K0 + step.K1 * v0 + step.K2 * v1 +
+            std::sqrt(step.K3 * v0 + step.K4 * v1) * (sign * (real)zS[i]);
+    v[i] = v1;
+  }
+}
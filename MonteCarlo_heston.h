@@ -0,0 +1,45 @@
+#ifndef MONTECARLO_HESTON_H
+#define MONTECARLO_HESTON_H
+
+#include <cstdint>
+
+#include "MonteCarlo_common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Heston stochastic variance, discretised by Andersen's quadratic-exponential
+// (QE) scheme. The variance of each step is drawn from a moment-matched
+// quadratic of a normal when its conditional law is concentrated (psi <= 1.5)
+// and from a mass at zero plus an exponential otherwise. The log-price then
+// follows with the central (gamma1 = gamma2 = 1/2) variance integral and the
+// martingale correction that makes the discounted price an exact martingale
+// of the scheme, so the terminal price stays an unbiased control variate.
+//
+// A tile of paths keeps its log-prices and variances in two arrays, and a
+// step updates both with branch-free selects between the two variance
+// schemes, so the inner loops run over contiguous paths with no divergence.
+// The spot normal of step k comes from Philox stream k, like a GBM path, and
+// the variance normal from stream FACTOR_STREAM + k (MonteCarlo_path.h).
+////////////////////////////////////////////////////////////////////////////////
+
+// Per-option constants of a QE step of length dt
+typedef struct {
+  // Conditional variance moments: m = theta + (v - theta) expKappaDt,
+  // s^2 = v varV + varTheta
+  real expKappaDt;
+  real theta;
+  real varV;
+  real varTheta;
+  // Log-price step: x += RDt + K0* + K1 v + K2 v' + sqrt(K3 v + K4 v') Z
+  real RDt;
+  real K1, K2, K3, K4;
+} THestonStep;
+
+void initHestonStep(THestonStep *step, const THeston &heston, double R,
+                    double dt);
+
+// Advance tileN paths by one step: x (log-return) and v (variance) in place,
+// from spot normals zS and variance normals zV, both multiplied by sign
+void hestonStep(const THestonStep &step, real *x, real *v, const float *zS,
+                const float *zV, real sign, int tileN);
+
+#endif
@@ -0,0 +1,806 @@
+////////////////////////////////////////////////////////////////////////////////
+// Device-side pricing. A device is a group of host cores running one worker
+// thread per core; workers pull (option, path chunk) tasks from the scheduler.
+////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "MonteCarlo_american.h"
+#include "MonteCarlo_basket.h"
+#include "MonteCarlo_common.h"
+#include "MonteCarlo_mlmc.h"
+#include "MonteCarlo_normal.h"
+#include "MonteCarlo_path.h"
+#include "MonteCarlo_reduction.h"
+#include "MonteCarlo_scheduler.h"
+#include "MonteCarlo_sobol.h"
+
+template <class T>
+static inline T endStockValue(T S, T r, T MuByT, T VBySqrtT) {
+  return S * std::exp(MuByT + VBySqrtT * r);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Two-sided 97.5% quantile of Student's t distribution, so replica-based
+// intervals keep 95% coverage with few replicas
+////////////////////////////////////////////////////////////////////////////////
+static double studentT975(int df) {
+  static const double t[30] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  return df >= 1 && df <= 30 ? t[df - 1] : 1.96;
+}
+
+// Interleaved per-lane sums of one path block. Samples enter as deviations
+// from a per-block shift, the block's first sample, so the sums of squares
+// stay small however large the mean; storeBlockMoments() turns them into the
+// block's moments.
+template <class Accum>
+struct TBlockLanes {
+  Accum sum[MOMENT_N][REDUCTION_LANES];
+  Accum sum2[MOMENT_N][REDUCTION_LANES];
+  // Sum of payoff times control deviations
+  Accum sumYC[REDUCTION_LANES];
+  // Antithetic pair spread (y_up - y_down)^2 / 2
+  Accum spread[REDUCTION_LANES];
+};
+
+// Add one sample unit u (one value per stream) to a lane
+template <class Accum, class Path>
+static inline void addSample(TBlockLanes<Accum> &lanes, int lane,
+                             const Path *u, const Path *shift, Path spread,
+                             bool antithetic, bool control, bool greeks) {
+  const Path dy = u[MOMENT_PAYOFF] - shift[MOMENT_PAYOFF];
+  lanes.sum[MOMENT_PAYOFF][lane] += dy;
+  lanes.sum2[MOMENT_PAYOFF][lane] += dy * dy;
+
+  if (antithetic) lanes.spread[lane] += spread;
+
+  if (control) {
+    const Path dc = u[MOMENT_CONTROL] - shift[MOMENT_CONTROL];
+    lanes.sum[MOMENT_CONTROL][lane] += dc;
+    lanes.sum2[MOMENT_CONTROL][lane] += dc * dc;
+    lanes.sumYC[lane] += dy * dc;
+  }
+
+  for (int s = MOMENT_GREEK; greeks && s < MOMENT_N; s++) {
+    const Path dg = u[s] - shift[s];
+    lanes.sum[s][lane] += dg;
+    lanes.sum2[s][lane] += dg * dg;
+  }
+}
+
+// Moments of the sampleN samples in the lanes of path block idx, shifted
+// back by shift. Streams the batch does not use come out zero.
+template <class Accum, class Path>
+static void storeBlockMoments(const TBatchPlan &batch,
+                              const TBlockLanes<Accum> &lanes,
+                              const Path *shift, int sampleN, int idx) {
+  TBlockMoments &m = batch.h_BlockMoments[idx];
+  const double n = sampleN;
+  double deviation[MOMENT_N];
+
+  m.n = n;
+  for (int s = 0; s < MOMENT_N; s++) {
+    const double sum = treeSum(lanes.sum[s], REDUCTION_LANES);
+    const double sum2 = treeSum(lanes.sum2[s], REDUCTION_LANES);
+    deviation[s] = sum / n;
+    m.mean[s] = (double)shift[s] + deviation[s];
+    m.m2[s] = sum2 - sum * deviation[s];
+    // Rounding can leave a zero M2 slightly negative
+    if (m.m2[s] < 0) m.m2[s] = 0;
+  }
+  m.coPayoffControl = (double)treeSum(lanes.sumYC, REDUCTION_LANES) -
+                      n * deviation[MOMENT_PAYOFF] * deviation[MOMENT_CONTROL];
+  m.pairSpread = treeSum(lanes.spread, REDUCTION_LANES);
+}
+
+// Per-option terms of the one-step fast path
+template <class Path>
+struct TOptionTerms {
+  Path S, X, MuByT, VBySqrtT, forward;
+  // Greeks only: T, sqrt(T) and V * T
+  Path T, sqrtT, VT;
+};
+
+// Pathwise Greeks of one call path ending at stock from sample z: the
+// derivatives of log S(T) are 1 / S, sqrt(T) z - V T and T, and the rate
+// also discounts the payoff y
+template <class Path>
+static inline void callGreeks(Path *g, Path stock, Path y, Path z,
+                              const TOptionTerms<Path> &o) {
+  const Path itm = stock > o.X ? stock : 0;
+  g[GREEK_DELTA] = itm / o.S;
+  g[GREEK_VEGA] = itm * (o.sqrtT * z - o.VT);
+  g[GREEK_RHO] = itm * o.T - o.T * y;
+}
+
+// Sample unit of one-step sample z: payoff, centred control and Greeks per
+// stream, and the pair spread in antithetic mode
+template <class Path, bool antithetic, bool greeks>
+static inline void callSample(Path *u, Path &spread, Path z,
+                              const TOptionTerms<Path> &o) {
+  Path stock = endStockValue(o.S, z, o.MuByT, o.VBySqrtT);
+  Path y = stock > o.X ? stock - o.X : 0;
+  Path c = stock - o.forward;
+  Path *g = u + MOMENT_GREEK;
+
+  if (greeks) callGreeks(g, stock, y, z, o);
+
+  if (antithetic) {
+    Path stockDown = endStockValue(o.S, -z, o.MuByT, o.VBySqrtT);
+    Path down = stockDown > o.X ? stockDown - o.X : 0;
+    spread = (Path)0.5 * (y - down) * (y - down);
+    y = (Path)0.5 * (y + down);
+    c = (Path)0.5 * (c + stockDown - o.forward);
+
+    if (greeks) {
+      Path gDown[GREEK_N];
+      callGreeks(gDown, stockDown, down, -z, o);
+      for (int k = 0; k < GREEK_N; k++) g[k] = (Path)0.5 * (g[k] + gDown[k]);
+    }
+  }
+
+  u[MOMENT_PAYOFF] = y;
+  u[MOMENT_CONTROL] = c;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Accumulate one path block from its samples. The sample unit Y is the call
+// payoff of one path, or the pair average of paths z and -z in antithetic
+// mode. The control C is the terminal stock price minus its known mean
+// S * exp(R * T), averaged over the pair likewise; so are the Greeks. Paths
+// are evaluated in P::Path and summed in P::Accum, as deviations from the
+// first sample unit, which is written to shift.
+////////////////////////////////////////////////////////////////////////////////
+template <class P, bool antithetic, bool control, bool greeks>
+static void accumulateBlock(TBlockLanes<typename P::Accum> &lanes,
+                            typename P::Path *shift, const float *z,
+                            int sampleN,
+                            const TOptionTerms<typename P::Path> &o) {
+  typedef typename P::Path Path;
+  Path u[MOMENT_N] = {}, spread = 0;
+
+  for (int s = 0; s < MOMENT_N; s++) shift[s] = 0;
+  callSample<Path, antithetic, greeks>(shift, spread, (Path)z[0], o);
+
+  for (int pos = 0; pos < sampleN; pos++) {
+    callSample<Path, antithetic, greeks>(u, spread, (Path)z[pos], o);
+    addSample(lanes, pos % REDUCTION_LANES, u, shift, spread, antithetic,
+              control, greeks);
+  }
+}
+
+// Price one-step call samples z of path block idx under policy P
+template <class P, bool antithetic, bool control, bool greeks>
+static void priceBlock(const TBatchPlan &batch, int option, const float *z,
+                       int sampleN, int idx) {
+  typedef typename P::Path Path;
+  const TOptionBatch &options = *batch.options;
+  TOptionTerms<Path> terms;
+  terms.S = (Path)options.S[option];
+  terms.X = (Path)options.X[option];
+  terms.MuByT = (Path)options.MuByT[option];
+  terms.VBySqrtT = (Path)options.VBySqrtT[option];
+  terms.forward = terms.S / (Path)options.DiscountRT[option];
+  terms.T = (Path)options.T[option];
+  terms.sqrtT = (Path)sqrt((double)options.T[option]);
+  terms.VT = (Path)options.V[option] * terms.T;
+
+  TBlockLanes<typename P::Accum> lanes = {};
+  Path shift[MOMENT_N];
+  accumulateBlock<P, antithetic, control, greeks>(lanes, shift, z, sampleN,
+                                                  terms);
+  storeBlockMoments(batch, lanes, shift, sampleN, idx);
+}
+
+typedef void (*TPriceBlock)(const TBatchPlan &, int, const float *, int, int);
+
+// priceBlock instance for the batch's policy and estimator
+template <class P>
+static TPriceBlock priceBlockFor(const TBatchPlan &batch) {
+  // Indexed by [antithetic][control][greeks]
+  static const TPriceBlock table[2][2][2] = {
+      {{priceBlock<P, false, false, false>, priceBlock<P, false, false, true>},
+       {priceBlock<P, false, true, false>, priceBlock<P, false, true, true>}},
+      {{priceBlock<P, true, false, false>, priceBlock<P, true, false, true>},
+       {priceBlock<P, true, true, false>, priceBlock<P, true, true, true>}}};
+  return table[batch.antithetic][batch.controlVariate][batch.greeks];
+}
+
+static TPriceBlock priceBlockFor(const TBatchPlan &batch) {
+  switch (batch.precision) {
+    case PRECISION_COMPENSATED:
+      return priceBlockFor<PrecisionCompensated>(batch);
+    case PRECISION_MIXED:
+      return priceBlockFor<PrecisionMixed>(batch);
+    case PRECISION_DOUBLE:
+      return priceBlockFor<PrecisionDouble>(batch);
+    default:
+      return priceBlockFor<PrecisionFloat>(batch);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Accumulate one path block of a multi-step or path-dependent option, a tile
+// of paths at a time. Lanes follow the sample position within the block as
+// in accumulateBlock, and the sample unit and shift are defined the same
+// way; the control is the path's raw control sample centred on
+// h_ControlMean. Basket Greeks are added to the block's adjoint sums
+// instead, over single paths.
+////////////////////////////////////////////////////////////////////////////////
+static void accumulatePathBlock(TBlockLanes<real> &lanes, real *shift,
+                                const TBatchPlan &batch, int optionIndex,
+                                uint64_t sampleBegin, int sampleN,
+                                real *adjoint) {
+  const real controlMean =
+      batch.controlVariate ? batch.h_ControlMean[optionIndex] : 0;
+  const real T = batch.options->T[optionIndex];
+  const bool greeks = batch.greeks && !adjoint;
+  real payoff[PATH_TILE_N], control[PATH_TILE_N];
+  real payoffDown[PATH_TILE_N], controlDown[PATH_TILE_N];
+  real greek[GREEK_N * PATH_TILE_N], greekDown[GREEK_N * PATH_TILE_N];
+  real u[MOMENT_N] = {}, spread = 0;
+
+  for (int tileFirst = 0; tileFirst < sampleN; tileFirst += PATH_TILE_N) {
+    int tileN = sampleN - tileFirst;
+    if (tileN > PATH_TILE_N) tileN = PATH_TILE_N;
+
+    if (adjoint) {
+      simulateBasketTile(batch, optionIndex, sampleBegin + tileFirst, tileN,
+                         1, payoff, control, adjoint);
+      if (batch.antithetic)
+        simulateBasketTile(batch, optionIndex, sampleBegin + tileFirst, tileN,
+                           -1, payoffDown, controlDown, adjoint);
+    } else {
+      simulatePathTile(batch, optionIndex, sampleBegin + tileFirst, tileN, 1,
+                       payoff, control, greeks ? greek : NULL);
+      if (batch.antithetic)
+        simulatePathTile(batch, optionIndex, sampleBegin + tileFirst, tileN,
+                         -1, payoffDown, controlDown,
+                         greeks ? greekDown : NULL);
+    }
+
+    for (int i = 0; i < tileN; i++) {
+      u[MOMENT_PAYOFF] = payoff[i];
+      u[MOMENT_CONTROL] = control[i] - controlMean;
+
+      if (batch.antithetic) {
+        const real d = payoff[i] - payoffDown[i];
+        spread = (real)0.5 * d * d;
+        u[MOMENT_PAYOFF] = (real)0.5 * (payoff[i] + payoffDown[i]);
+        u[MOMENT_CONTROL] =
+            (real)0.5 * (u[MOMENT_CONTROL] + controlDown[i] - controlMean);
+      }
+
+      // The rate also discounts the payoff
+      for (int k = 0; greeks && k < GREEK_N; k++) {
+        real g = greek[k * PATH_TILE_N + i];
+        if (k == GREEK_RHO) g -= T * payoff[i];
+        if (batch.antithetic) {
+          real gDown = greekDown[k * PATH_TILE_N + i];
+          if (k == GREEK_RHO) gDown -= T * payoffDown[i];
+          g = (real)0.5 * (g + gDown);
+        }
+        u[MOMENT_GREEK + k] = g;
+      }
+
+      if (tileFirst == 0 && i == 0)
+        for (int s = 0; s < MOMENT_N; s++) shift[s] = u[s];
+
+      addSample(lanes, (tileFirst + i) % REDUCTION_LANES, u, shift, spread,
+                batch.antithetic, batch.controlVariate, greeks);
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Price one path chunk of an option, writing the sums of each of its path
+// blocks into the batch. pathFirst must be a multiple of PATH_BLOCK_N.
+// Per-option terms are read from the SoA batch columns.
+////////////////////////////////////////////////////////////////////////////////
+static void MonteCarloOneChunk(const TBatchPlan &batch, int optionIndex,
+                               int pathFirst, int pathN) {
+  const TOptionBatch &options = *batch.options;
+  const TPhiloxKey key = philoxKey(batch.seed);
+  const bool antithetic = batch.antithetic;
+  // One-step GBM calls keep the fused single-sample loop below
+  const bool pathEngine = batch.stepN > 1 ||
+                          options.Payoff[optionIndex] != PAYOFF_CALL ||
+                          options.Model[optionIndex] != MODEL_GBM;
+  const bool basketAdjoint =
+      batch.greeks && options.Payoff[optionIndex] == PAYOFF_BASKET_CALL;
+  const TPriceBlock priceFastBlock = priceBlockFor(batch);
+
+  // N(0,1) samples of one path block, priced while they are still in L1,
+  // plus room for Philox block alignment
+  alignas(64) float samples[PATH_BLOCK_N + 8];
+  int idx = optionIndex * batch.blockN + pathFirst / PATH_BLOCK_N;
+
+  for (int blockFirst = 0; blockFirst < pathN;
+       blockFirst += PATH_BLOCK_N, idx++) {
+    int blockEnd = blockFirst + PATH_BLOCK_N;
+    if (blockEnd > pathN) blockEnd = pathN;
+
+    // Samples used by the block: one per path, or one per antithetic pair
+    const int pairShift = antithetic ? 1 : 0;
+    const uint64_t sampleBegin =
+        ((uint64_t)pathFirst + blockFirst) >> pairShift;
+    const uint64_t sampleEnd = ((uint64_t)pathFirst + blockEnd) >> pairShift;
+    const int sampleN = (int)(sampleEnd - sampleBegin);
+
+    if (pathEngine) {
+      TBlockLanes<real> lanes = {};
+      real shift[MOMENT_N] = {};
+      real *adjoint = NULL;
+      if (basketAdjoint) {
+        adjoint = batch.h_BlockSumAdjoint + (size_t)idx * batch.adjointN;
+        for (int j = 0; j < batch.adjointN; j++) adjoint[j] = 0;
+      }
+      accumulatePathBlock(lanes, shift, batch, optionIndex, sampleBegin,
+                          sampleN, adjoint);
+      storeBlockMoments(batch, lanes, shift, sampleN, idx);
+      continue;
+    }
+
+    const float *z = samples;
+
+    if (batch.qmcReplicaN > 0) {
+      // Path blocks never straddle replicas
+      sobolNormals(samples, sampleN, key, optionIndex,
+                   (int)(sampleBegin / batch.replicaPathN), 0,
+                   (uint32_t)(sampleBegin % batch.replicaPathN));
+    } else {
+      // Philox blocks covering the samples, which need not start on a block
+      const uint64_t philoxFirst = sampleBegin >> 2;
+      const int philoxN = (int)(((sampleEnd + 3) >> 2) - philoxFirst);
+      normalGenerator(samples, philoxFirst, philoxN, key, optionIndex, 0);
+      z = samples + (sampleBegin & 3);
+    }
+
+    priceFastBlock(batch, optionIndex, z, sampleN, idx);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Baseline of the fused loop above for --bench-fused: price every path
+// block of a one-step call option from its samples z, one per path or per
+// antithetic pair, which a separate generation pass has already written to
+// memory
+////////////////////////////////////////////////////////////////////////////////
+void MonteCarloBufferedOption(const TBatchPlan &batch, int option,
+                              const float *z) {
+  const TPriceBlock priceFastBlock = priceBlockFor(batch);
+  const int pairShift = batch.antithetic ? 1 : 0;
+  int idx = option * batch.blockN;
+
+  for (int blockFirst = 0; blockFirst < batch.pathN;
+       blockFirst += PATH_BLOCK_N, idx++) {
+    const int blockEnd = std::min(blockFirst + PATH_BLOCK_N, batch.pathN);
+    const int sampleBegin = blockFirst >> pairShift;
+    const int sampleN = (blockEnd >> pairShift) - sampleBegin;
+    priceFastBlock(batch, option, z + sampleBegin, sampleN, idx);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Price one path chunk of one level of a multilevel option into the path
+// blocks of its row. The sample unit is the fine minus the coarse payoff of
+// a coupled path; the fine payoff goes into the control stream, for the
+// single-level comparison.
+////////////////////////////////////////////////////////////////////////////////
+static void MonteCarloLevelChunk(const TBatchPlan &batch, int option,
+                                 int level, int pathFirst, int pathN) {
+  real fine[PATH_TILE_N], coarse[PATH_TILE_N];
+  int idx = levelRow(batch, option, level) * batch.blockN +
+            pathFirst / PATH_BLOCK_N;
+
+  for (int blockFirst = 0; blockFirst < pathN;
+       blockFirst += PATH_BLOCK_N, idx++) {
+    const int sampleN = std::min(PATH_BLOCK_N, pathN - blockFirst);
+    TBlockLanes<real> lanes = {};
+    real u[MOMENT_N] = {}, shift[MOMENT_N] = {};
+
+    for (int tileFirst = 0; tileFirst < sampleN; tileFirst += PATH_TILE_N) {
+      const int tileN = std::min(PATH_TILE_N, sampleN - tileFirst);
+      simulateLevelTile(batch, option, level,
+                        (uint64_t)pathFirst + blockFirst + tileFirst, tileN,
+                        fine, coarse);
+
+      for (int i = 0; i < tileN; i++) {
+        u[MOMENT_PAYOFF] = fine[i] - coarse[i];
+        u[MOMENT_CONTROL] = fine[i];
+        if (tileFirst == 0 && i == 0)
+          for (int s = 0; s < MOMENT_N; s++) shift[s] = u[s];
+        addSample(lanes, (tileFirst + i) % REDUCTION_LANES, u, shift,
+                  (real)0, false, true, false);
+      }
+    }
+
+    storeBlockMoments(batch, lanes, shift, sampleN, idx);
+  }
+}
+
+// Undiscounted mean of an option's raw control sample
+static real controlMean(const TOptionBatch &options, int option, int stepN) {
+  if (options.Payoff[option] == PAYOFF_BASKET_CALL) {
+    const TBasket &basket = options.baskets[options.Basket[option]];
+    double spot = 0;
+    for (int a = 0; a < basket.assetN; a++)
+      spot += (double)basket.Weight[a] * basket.S[a];
+    return (real)(spot / options.DiscountRT[option]);
+  }
+  if (options.Payoff[option] != PAYOFF_ASIAN_CALL)
+    return options.S[option] / options.DiscountRT[option];
+
+  const TOptionData data = {options.S[option], options.X[option],
+                            options.T[option], options.R[option],
+                            options.V[option]};
+  return (real)(GeometricAsianCall(data, stepN) /
+                (double)options.DiscountRT[option]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocate the batch-wide path block sums and task deques
+////////////////////////////////////////////////////////////////////////////////
+void initMonteCarloBatch(TBatchPlan *batch, int deviceN, bool steal) {
+  // Antithetic pairs must not straddle a path block or the end of the budget
+  if (batch->antithetic) batch->pathN += batch->pathN & 1;
+  if (batch->qmcReplicaN > 0) {
+    const int replicaPathN =
+        (batch->pathN + batch->qmcReplicaN - 1) / batch->qmcReplicaN;
+    batch->replicaPathN =
+        (replicaPathN + PATH_BLOCK_N - 1) / PATH_BLOCK_N * PATH_BLOCK_N;
+    batch->pathN = batch->qmcReplicaN * batch->replicaPathN;
+  }
+  batch->chunkPathN =
+      (batch->chunkPathN + PATH_BLOCK_N - 1) / PATH_BLOCK_N * PATH_BLOCK_N;
+  batch->chunkN = (batch->pathN + batch->chunkPathN - 1) / batch->chunkPathN;
+  batch->blockN = (batch->pathN + PATH_BLOCK_N - 1) / PATH_BLOCK_N;
+  if (batch->roundChunkN < 1 || batch->roundChunkN > batch->chunkN)
+    batch->roundChunkN = batch->chunkN;
+  if (batch->stepN < 1) batch->stepN = 1;
+  batch->bridge = TBrownianBridge();
+  if (batch->qmcReplicaN > 0) initBrownianBridge(&batch->bridge, batch->stepN);
+  batch->h_PathN = new int[batch->optionN]();
+  const int rowN = batch->optionN * std::max(batch->levelN, 1);
+  batch->h_BlockMoments = new TBlockMoments[(size_t)rowN * batch->blockN];
+  batch->h_LevelN = batch->levelN > 0 ? new int[batch->optionN]() : NULL;
+  batch->h_LevelPathN = batch->levelN > 0 ? new int[rowN]() : NULL;
+  batch->h_ControlMean = batch->controlVariate ? new real[batch->optionN] : NULL;
+  for (int i = 0; batch->controlVariate && i < batch->optionN; i++)
+    batch->h_ControlMean[i] = controlMean(*batch->options, i, batch->stepN);
+  batch->adjointN = 0;
+  for (int i = 0; batch->greeks && i < batch->optionN; i++) {
+    const TOptionBatch &options = *batch->options;
+    if (options.Payoff[i] != PAYOFF_BASKET_CALL) continue;
+    const int adjointN =
+        basketAdjointN(options.baskets[options.Basket[i]].assetN);
+    if (adjointN > batch->adjointN) batch->adjointN = adjointN;
+  }
+  batch->h_BlockSumAdjoint =
+      batch->adjointN > 0
+          ? new real[(size_t)batch->optionN * batch->blockN * batch->adjointN]
+          : NULL;
+  batch->h_VarianceRatio = new real[batch->optionN];
+  batch->scheduler = new TaskScheduler(deviceN, steal);
+}
+
+void closeMonteCarloBatch(TBatchPlan *batch) {
+  delete[] batch->h_BlockMoments;
+  delete[] batch->h_LevelN;
+  delete[] batch->h_LevelPathN;
+  delete[] batch->h_ControlMean;
+  delete[] batch->h_BlockSumAdjoint;
+  delete[] batch->h_VarianceRatio;
+  delete[] batch->h_PathN;
+  delete batch->scheduler;
+  if (batch->bridge.stepN > 0) closeBrownianBridge(&batch->bridge);
+}
+
+// American options are priced by one whole-option task
+static bool isWholeOptionTask(const TBatchPlan *batch, int option) {
+  return batch->options->Payoff[option] == PAYOFF_AMERICAN_PUT;
+}
+
+// Paths covered by the first chunkN chunks of an option
+static int chunkPathEnd(const TBatchPlan *batch, int chunkN) {
+  long long pathN = (long long)chunkN * batch->chunkPathN;
+  return pathN < batch->pathN ? (int)pathN : batch->pathN;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Queue the first round of chunks of the plan's home slice on its device
+////////////////////////////////////////////////////////////////////////////////
+void initMonteCarloDevice(TOptionPlan *plan) {
+  TBatchPlan *batch = plan->batch;
+
+  for (int i = 0; i < plan->optionCount; i++) {
+    const int option = plan->optionFirst + i;
+
+    if (batch->levelN > 0) {
+      initMlmcOption(batch, option, plan->device.id);
+      continue;
+    }
+
+    if (isWholeOptionTask(batch, option)) {
+      batch->scheduler->push(plan->device.id, {option, 0, 0});
+      batch->h_PathN[option] = batch->pathN;
+      continue;
+    }
+
+    for (int c = 0; c < batch->roundChunkN; c++)
+      batch->scheduler->push(plan->device.id, {option, c, 0});
+    batch->h_PathN[option] = chunkPathEnd(batch, batch->roundChunkN);
+  }
+
+  plan->tasksDone = 0;
+  plan->tasksStolen = 0;
+  plan->pathsDone = 0;
+  plan->time = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Queue the next round of chunks for every option that has neither reached
+// its tolerance nor exhausted the path budget. The tasks are dealt to devices
+// round-robin, so capacity freed by converged options goes to the remaining
+// ones wherever their home slice was. Returns the number of tasks queued.
+////////////////////////////////////////////////////////////////////////////////
+int scheduleMonteCarloRound(TBatchPlan *batch, int deviceN) {
+  int taskN = 0;
+
+  for (int option = 0; option < batch->optionN; option++) {
+    if (batch->levelN > 0) {
+      taskN += scheduleMlmcOption(batch, option, deviceN, taskN);
+      continue;
+    }
+
+    if (batch->h_PathN[option] >= batch->pathN) continue;
+    if (batch->callValue[option].Confidence <
+        batch->options->Tolerance[option])
+      continue;
+
+    const int chunkFirst = batch->h_PathN[option] / batch->chunkPathN;
+    int chunkEnd = chunkFirst + batch->roundChunkN;
+    if (chunkEnd > batch->chunkN) chunkEnd = batch->chunkN;
+
+    for (int c = chunkFirst; c < chunkEnd; c++)
+      batch->scheduler->push(taskN++ % deviceN, {option, c, 0});
+    batch->h_PathN[option] = chunkPathEnd(batch, chunkEnd);
+  }
+
+  return taskN;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Run tasks on the cores of the plan's device until neither its own deque nor
+// any neighbour's has work left. Samples come from the Philox stream keyed by
+// the batch seed and addressed by (option, path index), so a chunk draws the
+// same samples whichever device runs it and whatever the chunk size.
+////////////////////////////////////////////////////////////////////////////////
+void MonteCarloDevice(TOptionPlan *plan) {
+  auto start = std::chrono::steady_clock::now();
+
+  TBatchPlan *batch = plan->batch;
+  const int threadN = plan->device.coreCount;
+  struct Counters {
+    int tasksDone = 0;
+    int tasksStolen = 0;
+    long long pathsDone = 0;
+  };
+  std::vector<Counters> counters(threadN);
+  std::vector<std::thread> workers;
+
+  for (int t = 0; t < threadN; t++) {
+    workers.emplace_back([plan, batch, t, &counters]() {
+      bindThreadToCore(plan->device.coreFirst + t);
+
+      Counters &count = counters[t];
+
+      TTask task;
+      bool stolen;
+
+      while (batch->scheduler->pop(plan->device.id, task, stolen)) {
+        int pathFirst = task.chunk * batch->chunkPathN;
+        int pathN = batch->pathN - pathFirst;
+        if (pathN > batch->chunkPathN) pathN = batch->chunkPathN;
+
+        if (isWholeOptionTask(batch, task.option)) {
+          pathN = batch->pathN;
+          MonteCarloAmerican(*batch, task.option);
+        } else if (batch->levelN > 0) {
+          // Multilevel tasks run up to a chunk of paths from a path block,
+          // stopping at the end of the level's scheduled paths
+          const int row = levelRow(*batch, task.option, task.level);
+          pathFirst = task.chunk * PATH_BLOCK_N;
+          pathN = std::min(batch->chunkPathN,
+                           batch->h_LevelPathN[row] - pathFirst);
+          MonteCarloLevelChunk(*batch, task.option, task.level, pathFirst,
+                               pathN);
+        } else {
+          MonteCarloOneChunk(*batch, task.option, pathFirst, pathN);
+        }
+
+        count.tasksDone++;
+        count.tasksStolen += stolen;
+        count.pathsDone += pathN;
+      }
+    });
+  }
+
+  for (auto &w : workers) w.join();
+
+  for (int t = 0; t < threadN; t++) {
+    plan->tasksDone += counters[t].tasksDone;
+    plan->tasksStolen += counters[t].tasksStolen;
+    plan->pathsDone += counters[t].pathsDone;
+  }
+
+  plan->time += std::chrono::duration<float, std::milli>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+}
+
+// Estimate of one stream's mean over the first blockN path blocks of an
+// option, from their merged moments
+typedef struct {
+  double mean;
+  // Variance of one sample, and the variance actually achieved, scaled so
+  // that var / sampleN is the variance of the estimator
+  double varSample;
+  double var;
+  // 95% quantile of the estimator's distribution
+  double quantile;
+} TEstimate;
+
+static TEstimate streamEstimate(const TBatchPlan *batch, int option,
+                                const TBlockMoments &moments, int stream) {
+  TEstimate e;
+
+  e.mean = moments.mean[stream];
+  e.var = moments.n > 1 ? moments.m2[stream] / (moments.n - 1) : 0;
+  e.varSample = e.var;
+  e.quantile = 1.96;
+
+  // Randomised QMC: the replica means are the iid samples, taken in two
+  // passes since there are few of them
+  if (batch->qmcReplicaN > 0) {
+    const int R = batch->qmcReplicaN;
+    const int replicaBlockN = batch->replicaPathN / PATH_BLOCK_N;
+    const TBlockMoments *blocks =
+        batch->h_BlockMoments + option * batch->blockN;
+    std::vector<double> meanR(R);
+    double sumR = 0, m2R = 0;
+
+    for (int r = 0; r < R; r++) {
+      meanR[r] = treeSum(blocks + r * replicaBlockN, replicaBlockN)
+                     .mean[stream];
+      sumR += meanR[r];
+    }
+    e.mean = sumR / R;
+    for (int r = 0; r < R; r++)
+      m2R += (meanR[r] - e.mean) * (meanR[r] - e.mean);
+
+    e.var = R > 1 ? m2R / (R - 1) * moments.n / R : 0;
+    e.quantile = studentT975(R - 1);
+  }
+
+  return e;
+}
+
+// Discounted mean of a basket option's adjoint sums, scale = RT / pathN,
+// pulled back to its gradient. Each entry is summed over blocks with the
+// same fixed-shape tree as the payoff.
+static void reduceBasketGradient(const TBatchPlan *batch, int option,
+                                 int blockN, double scale) {
+  const TBasket &basket =
+      batch->options->baskets[batch->options->Basket[option]];
+  const int adjointN = basketAdjointN(basket.assetN);
+  std::vector<real> column(blockN);
+  std::vector<double> adjoint(adjointN);
+
+  for (int j = 0; j < adjointN; j++) {
+    for (int b = 0; b < blockN; b++)
+      column[b] = batch->h_BlockSumAdjoint[((size_t)option * batch->blockN +
+                                            b) * batch->adjointN + j];
+    adjoint[j] = scale * treeSum(column.data(), blockN);
+  }
+
+  basketGradient(basket, adjoint.data(),
+                 batch->gradient + (size_t)option * batch->gradientN);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Combine the path block sums of the plan's home slice into option values
+// with a fixed-shape tree, over the paths scheduled so far. Must run after
+// every device has drained the current round.
+////////////////////////////////////////////////////////////////////////////////
+void reduceMonteCarloDevice(TOptionPlan *plan) {
+  TBatchPlan *batch = plan->batch;
+
+  for (int i = 0; i < plan->optionCount; i++) {
+    const int option = plan->optionFirst + i;
+
+    if (batch->levelN > 0) {
+      reduceMlmcOption(batch, option, plan->callValue[i]);
+      continue;
+    }
+
+    const int blockN = (batch->h_PathN[option] + PATH_BLOCK_N - 1) /
+                       PATH_BLOCK_N;
+    const double RT = batch->options->DiscountRT[option];
+    const double pathN = batch->h_PathN[option];
+    // Antithetic pairs, not their correlated halves, are the iid samples
+    const double pathsPerSample = batch->antithetic ? 2 : 1;
+    const double sampleN = pathN / pathsPerSample;
+
+    const TBlockMoments moments =
+        treeSum(batch->h_BlockMoments + option * batch->blockN, blockN);
+    const TEstimate price =
+        streamEstimate(batch, option, moments, MOMENT_PAYOFF);
+    double mean = price.mean;
+    double var = price.var;
+
+    // Control variate: with C centred on its known mean, the estimator
+    // mean(Y) - beta * mean(C) is unbiased for any beta, and the variance
+    // minimising beta = Cov(Y, C) / Var(C) is estimated from the moments of
+    // the paths run so far
+    if (batch->controlVariate) {
+      const double varC = moments.m2[MOMENT_CONTROL] / (sampleN - 1);
+      const double covYC = moments.coPayoffControl / (sampleN - 1);
+
+      if (varC > 0) {
+        const double beta = covYC / varC;
+        mean -= beta * moments.mean[MOMENT_CONTROL];
+        // Where C explains Y exactly the residual is known only up to the
+        // rounding of Var(Y)
+        var = std::max(var - covYC * beta, price.var * DBL_EPSILON);
+      }
+    }
+
+    // Discount the average by riskfree rate
+    plan->callValue[i].Expected = (real)(RT * mean);
+    // Confidence width; in 95% of all cases theoretical value lies within
+    // these borders
+    plan->callValue[i].Confidence =
+        (real)(RT * price.quantile * sqrt(var / sampleN));
+
+    // Variance of plain sampling with the same path count over the variance
+    // actually achieved. Each antithetic pair adds its spread to the M2 of
+    // its two paths about their common mean. A ratio above the sample count
+    // means the residual summed over all samples is less than the variance
+    // of one plain path: the run cannot resolve it (a deep in-the-money
+    // call's control is exact up to rounding), so it is reported as 0 too.
+    double varPath = price.varSample;
+    if (batch->antithetic)
+      varPath = (2 * moments.m2[MOMENT_PAYOFF] + moments.pairSpread) /
+                (pathN - 1);
+    const double ratio = var > 0 ? varPath / (pathsPerSample * var) : 0;
+    batch->h_VarianceRatio[option] = ratio < sampleN ? (real)ratio : 0;
+
+    const bool basket =
+        batch->options->Payoff[option] == PAYOFF_BASKET_CALL;
+    if (batch->greeks && basket)
+      reduceBasketGradient(batch, option, blockN, RT / pathN);
+
+    // Greeks come from the same paths, without the control variate
+    for (int k = 0; k < GREEK_N; k++) {
+      if (!batch->greeks || basket) {
+        plan->callValue[i].Greek[k] = 0;
+        plan->callValue[i].GreekConfidence[k] = 0;
+        continue;
+      }
+
+      const TEstimate greek =
+          streamEstimate(batch, option, moments, MOMENT_GREEK + k);
+      plan->callValue[i].Greek[k] = (real)(RT * greek.mean);
+      plan->callValue[i].GreekConfidence[k] =
+          (real)(RT * greek.quantile * sqrt(greek.var / sampleN));
+    }
+  }
+}
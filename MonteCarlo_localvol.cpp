@@ -0,0 +1,123 @@
+////////////////////////////////////////////////////////////////////////////////
+// Local volatility surfaces: tiled bilinear coefficients and path steps
+////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "MonteCarlo_localvol.h"
+
+// Coefficients per cell
+enum { COEFF_C0, COEFF_C1, COEFF_C2, COEFF_C3, COEFF_N };
+
+// Coefficients per cache line
+static const int LINE_N = 64 / sizeof(real);
+
+static const real *coefficientRow(const TLocalVol &surface, int row,
+                                  int coefficient) {
+  return surface.coefficients +
+         ((size_t)row * COEFF_N + coefficient) * surface.rowStride;
+}
+
+bool initLocalVol(TLocalVol *surface, int timeN, int spotN, double spot,
+                  double dt, double xFirst, double dx) {
+  // Slices hold one entry per cell in fixed arrays
+  if (timeN < 2 || spotN < 2 || spotN > MAX_LOCALVOL_SPOT_N) return false;
+
+  const int rowStride = (spotN - 1 + LINE_N - 1) / LINE_N * LINE_N;
+  const size_t n = (size_t)(timeN - 1) * COEFF_N * rowStride;
+
+  surface->timeN = timeN;
+  surface->spotN = spotN;
+  surface->rowStride = rowStride;
+  surface->spot = (real)spot;
+  surface->dt = (real)dt;
+  surface->xFirst = (real)xFirst;
+  surface->dx = (real)dx;
+  surface->coefficients = (real *)aligned_alloc(64, n * sizeof(real));
+  memset(surface->coefficients, 0, n * sizeof(real));
+  return true;
+}
+
+void closeLocalVol(TLocalVol *surface) { free(surface->coefficients); }
+
+void fitLocalVol(TLocalVol *surface, const double *sigma) {
+  const int spotN = surface->spotN;
+  const double invDx = 1.0 / surface->dx, invDt = 1.0 / surface->dt;
+
+  for (int j = 0; j + 1 < surface->timeN; j++) {
+    const double t = j * (double)surface->dt;
+    real *row = surface->coefficients +
+                (size_t)j * COEFF_N * surface->rowStride;
+
+    for (int i = 0; i + 1 < spotN; i++) {
+      const double x = surface->xFirst + i * (double)surface->dx;
+      const double *s0 = sigma + (size_t)j * spotN + i;
+      const double *s1 = s0 + spotN;
+      // sigma = s00 + d1 (x - x_i) + d2 (t - t_j) + d3 (x - x_i)(t - t_j)
+      const double d1 = (s0[1] - s0[0]) * invDx;
+      const double d2 = (s1[0] - s0[0]) * invDt;
+      const double d3 = (s1[1] - s1[0] - s0[1] + s0[0]) * invDx * invDt;
+
+      row[COEFF_C0 * surface->rowStride + i] =
+          (real)(s0[0] - d1 * x - d2 * t + d3 * x * t);
+      row[COEFF_C1 * surface->rowStride + i] = (real)(d1 - d3 * t);
+      row[COEFF_C2 * surface->rowStride + i] = (real)(d2 - d3 * x);
+      row[COEFF_C3 * surface->rowStride + i] = (real)d3;
+    }
+  }
+}
+
+// Time row of t, and t clamped to the grid
+static int timeRow(const TLocalVol &surface, double &t) {
+  const double tLast = (surface.timeN - 1) * (double)surface.dt;
+  t = std::min(std::max(t, 0.0), tLast);
+  return std::min((int)(t / surface.dt), surface.timeN - 2);
+}
+
+void localVolSlice(TLocalVolSlice *slice, const TLocalVol &surface,
+                   double t) {
+  const int row = timeRow(surface, t);
+  const real *c0 = coefficientRow(surface, row, COEFF_C0);
+  const real *c1 = coefficientRow(surface, row, COEFF_C1);
+  const real *c2 = coefficientRow(surface, row, COEFF_C2);
+  const real *c3 = coefficientRow(surface, row, COEFF_C3);
+  const real tr = (real)t;
+
+  slice->cellN = surface.spotN - 1;
+  slice->xFirst = surface.xFirst;
+  slice->xLast = surface.xFirst + slice->cellN * surface.dx;
+  slice->invDx = 1 / surface.dx;
+  for (int i = 0; i < slice->cellN; i++) {
+    slice->alpha[i] = c0[i] + c2[i] * tr;
+    slice->beta[i] = c1[i] + c3[i] * tr;
+  }
+}
+
+void localVolStep(const TLocalVolSlice &slice, real *x, const float *z,
+                  real sign, real xShift, real RDt, real dt, int tileN) {
+  const real sqrtDt = std::sqrt(dt);
+  const real xFirst = slice.xFirst, xLast = slice.xLast;
+  const real invDx = slice.invDx;
+  const int lastCell = slice.cellN - 1;
+  // Lookups go to a local array first, which x cannot alias, so that both
+  // loops vectorise
+  const int chunkN = 64;
+  real sigma[chunkN];
+
+  for (int first = 0; first < tileN; first += chunkN) {
+    const int n = std::min(chunkN, tileN - first);
+
+    for (int i = 0; i < n; i++) {
+      const real xi = x[first + i] + xShift;
+      const real xs = xi < xFirst ? xFirst : xi > xLast ? xLast : xi;
+      const int cell = std::min((int)((xs - xFirst) * invDx), lastCell);
+      sigma[i] = slice.alpha[cell] + slice.beta[cell] * xs;
+    }
+
+    for (int i = 0; i < n; i++)
+      x[first + i] += RDt - (real)0.5 * sigma[i] * sigma[i] * dt +
+                      sigma[i] * sqrtDt * (sign * (real)z[first + i]);
+  }
+}
@@ -0,0 +1,45 @@
+#ifndef MONTECARLO_LOCALVOL_H
+#define MONTECARLO_LOCALVOL_H
+
+#include "MonteCarlo_common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Local volatility surfaces (TLocalVol). The surface stores bilinear
+// coefficients per cell instead of node values. A time step collapses its
+// time row into a slice, sigma(x) = alpha_i + beta_i x on cell i. That costs
+// two multiply-adds per cell, once per tile and step. After that, a path's
+// lookup is a clamp, an index computed from the uniform spacing, two gathers
+// from arrays of at most MAX_LOCALVOL_SPOT_N entries and one multiply-add.
+// Options sharing a surface read the same few cache lines on every step.
+//
+// Paths take log-Euler steps with sigma frozen at the start of the step. Each
+// step's growth factor then has conditional mean exp(R dt), so the terminal
+// price stays an exact control variate.
+////////////////////////////////////////////////////////////////////////////////
+// Allocate a surface; returns false, allocating nothing, unless it has at
+// least two times and between two and MAX_LOCALVOL_SPOT_N spot nodes
+bool initLocalVol(TLocalVol *surface, int timeN, int spotN, double spot,
+                  double dt, double xFirst, double dx);
+void closeLocalVol(TLocalVol *surface);
+
+// Fit the cell coefficients to node volatilities sigma[j * spotN + i] at
+// time j dt and log-moneyness xFirst + i dx
+void fitLocalVol(TLocalVol *surface, const double *sigma);
+
+// Slice of a surface at one time
+typedef struct {
+  int cellN;
+  real xFirst, xLast, invDx;
+  alignas(64) real alpha[MAX_LOCALVOL_SPOT_N];
+  alignas(64) real beta[MAX_LOCALVOL_SPOT_N];
+} TLocalVolSlice;
+
+void localVolSlice(TLocalVolSlice *slice, const TLocalVol &surface, double t);
+
+// Advance the log-returns x of tileN paths by one step of length dt from
+// normals z multiplied by sign. xShift = log(S0 / spot) maps a log-return
+// onto the surface's log-moneyness.
+void localVolStep(const TLocalVolSlice &slice, real *x, const float *z,
+                  real sign, real xShift, real RDt, real dt, int tileN);
+
+#endif
@@ -0,0 +1,61 @@
+////////////////////////////////////////////////////////////////////////////////
+// Merton jump-diffusion: batched jump counts and sizes
+////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <cmath>
+
+#include "MonteCarlo_merton.h"
+#include "MonteCarlo_normal.h"
+
+// Box-Muller normals from 24-bit uniforms stay within sqrt(48 log 2) =
+// 5.7681 in magnitude; the bound leaves room for rounding
+static const double NORMAL_BOUND = 5.77;
+
+void initMertonStep(TMertonStep *step, const TMerton &merton, double R,
+                    double V, double dt) {
+  const double kbar = exp(merton.muJ + 0.5 * merton.deltaJ * merton.deltaJ) - 1;
+  const double m = merton.lambda * dt;
+  // Upper tails P(N > n), summed from the far end so that tiny tails keep
+  // their digits; Phi^-1(P(N <= n)) = -Phi^-1(P(N > n))
+  const int termN = MAX_JUMP_N + 64;
+  double pmf[MAX_JUMP_N + 64];
+  double tail = 0;
+
+  pmf[0] = exp(-m);
+  for (int n = 1; n < termN; n++) pmf[n] = pmf[n - 1] * m / n;
+
+  step->thresholdN = 0;
+  for (int n = termN - 1; n >= 0; n--) {
+    const double q = tail > 0 ? -inverseNormalCDF(tail) : INFINITY;
+    if (n < MAX_JUMP_N && q < NORMAL_BOUND) {
+      step->thresholdN = std::max(step->thresholdN, n + 1);
+      step->threshold[n] = (real)q;
+      step->scaleStep[n] = (real)(merton.deltaJ * (sqrt(n + 1.0) - sqrt(n)));
+    }
+    tail += pmf[n];
+  }
+
+  step->drift = (real)((R - merton.lambda * kbar - 0.5 * V * V) * dt);
+  step->VSqrtDt = (real)(V * sqrt(dt));
+  step->muJ = merton.muJ;
+}
+
+void mertonStep(const TMertonStep &step, real *x, const float *z,
+                const float *zCount, const float *zJump, real sign,
+                int tileN) {
+  const real muJ = step.muJ;
+
+  for (int i = 0; i < tileN; i++)
+    x[i] += step.drift + step.VSqrtDt * (sign * (real)z[i]);
+
+  // Passing threshold j adds muJ + deltaJ (sqrt(j + 1) - sqrt(j)) Z, so the
+  // passes sum to N muJ + deltaJ sqrt(N) Z. One accumulation per pass keeps
+  // the path loop free of control flow.
+  for (int j = 0; j < step.thresholdN; j++) {
+    const real q = step.threshold[j], dScale = step.scaleStep[j];
+    for (int i = 0; i < tileN; i++) {
+      const real jump = sign * (real)zCount[i] > q ? 1 : 0;
+      x[i] += jump * (muJ + dScale * (sign * (real)zJump[i]));
+    }
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef MONTECARLO_MERTON_H
+#define MONTECARLO_MERTON_H
+
+#include "MonteCarlo_common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Merton jump-diffusion steps. The jumps of one step enter as a batch, not
+// path by path. Given the step's jump count N, the sum of the N log-jumps is
+// N muJ + deltaJ sqrt(N) Z, so one normal covers any number of jumps. The
+// count is Poisson(lambda dt), sampled by inverting a normal: N is the
+// number of thresholds q_n = Phi^-1(P(N <= n)) that the count normal
+// exceeds. The thresholds are computed once per option. A tile adds its
+// jumps in one compare-and-add pass per threshold over contiguous paths. Each
+// pass contributes muJ plus its increment of deltaJ sqrt(N) Z. No path takes
+// a branch of its own, and the passes vectorise. Thresholds beyond the
+// largest normal the generator can return are dropped, so a step makes
+// about as many passes as jumps are plausible in it.
+//
+// Step k draws its diffusion normal from Philox stream k, its count normal
+// from FACTOR_STREAM + k and its jump size normal from 2 FACTOR_STREAM + k
+// (MonteCarlo_path.h).
+////////////////////////////////////////////////////////////////////////////////
+
+// Jumps per step the thresholds resolve; P(N > MAX_JUMP_N) is dropped
+const int MAX_JUMP_N = 16;
+
+// Per-option constants of a step of length dt
+typedef struct {
+  // Compensated drift (R - lambda kbar - V^2 / 2) dt and V sqrt(dt)
+  real drift;
+  real VSqrtDt;
+  real muJ;
+  // The thresholdN thresholds of the count normal. Passing threshold n adds
+  // deltaJ (sqrt(n + 1) - sqrt(n)) to the jump size's scale.
+  int thresholdN;
+  real threshold[MAX_JUMP_N];
+  real scaleStep[MAX_JUMP_N];
+} TMertonStep;
+
+void initMertonStep(TMertonStep *step, const TMerton &merton, double R,
+                    double V, double dt);
+
+// Advance the log-returns x of tileN paths by one step from diffusion,
+// count and jump size normals, all multiplied by sign
+void mertonStep(const TMertonStep &step, real *x, const float *z,
+                const float *zCount, const float *zJump, real sign,
+                int tileN);
+
+#endif
@@ -0,0 +1,163 @@
+////////////////////////////////////////////////////////////////////////////////
+// Multilevel Monte Carlo: level allocation, bias test and reduction
+////////////////////////////////////////////////////////////////////////////////
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <vector>
+
+#include "MonteCarlo_mlmc.h"
+#include "MonteCarlo_path.h"
+#include "MonteCarlo_reduction.h"
+#include "MonteCarlo_scheduler.h"
+
+// Merged moments of the paths of one level scheduled so far
+static TBlockMoments levelMoments(const TBatchPlan *batch, int option,
+                                  int level) {
+  const int row = levelRow(*batch, option, level);
+  return treeSum(batch->h_BlockMoments + (size_t)row * batch->blockN,
+                 (batch->h_LevelPathN[row] + PATH_BLOCK_N - 1) / PATH_BLOCK_N);
+}
+
+static double levelVariance(const TBlockMoments &moments) {
+  return moments.n > 1 ? moments.m2[MOMENT_PAYOFF] / (moments.n - 1) : 0;
+}
+
+// Steps per path of a level, fine and coarse
+static double levelCost(const TBatchPlan *batch, int level) {
+  return levelStepN(*batch, level) * (level > 0 ? 1.5 : 1.0);
+}
+
+// Undiscounted bias of an option's estimator: the next level's correction,
+// extrapolated from the finest two level means with weak order alpha fitted
+// to the level means of l >= 1 (and at least 1/2)
+static double levelBias(const TBatchPlan *batch, int option) {
+  const int L = batch->h_LevelN[option];
+  if (L < 2) return INFINITY;
+
+  std::vector<double> mean(L);
+  double sumL = 0, sumLog = 0, sumL2 = 0, sumLLog = 0;
+  int pointN = 0;
+
+  for (int l = 0; l < L; l++) {
+    mean[l] = fabs(levelMoments(batch, option, l).mean[MOMENT_PAYOFF]);
+    if (l == 0 || mean[l] == 0) continue;
+    sumL += l;
+    sumLog += log2(mean[l]);
+    sumL2 += (double)l * l;
+    sumLLog += l * log2(mean[l]);
+    pointN++;
+  }
+
+  double alpha = 0.5;
+  if (pointN >= 2)
+    alpha = std::max(alpha, -(pointN * sumLLog - sumL * sumLog) /
+                                (pointN * sumL2 - sumL * sumL));
+  const double scale = pow(2.0, alpha);
+  return std::max(mean[L - 1], mean[L - 2] / scale) / (scale - 1);
+}
+
+// Extend a level to pathEnd paths, rounded up to whole path tiles and
+// capped at the per-level budget. The new paths are queued as tasks of up
+// to chunkPathN paths, on device or, when deviceN > 1, round-robin from task
+// taskFirst; a partly filled last block is priced again from its start.
+// Returns the tasks queued.
+static int extendLevel(TBatchPlan *batch, int option, int level,
+                       double pathEnd, int device, int deviceN,
+                       int taskFirst) {
+  const int row = levelRow(*batch, option, level);
+  const int budget = batch->blockN * PATH_BLOCK_N;
+  const int end = (int)std::min(
+      (double)budget, ceil(pathEnd / PATH_TILE_N) * PATH_TILE_N);
+  const int pathN = batch->h_LevelPathN[row];
+  int taskN = 0;
+
+  if (end <= pathN) return 0;
+
+  for (int first = pathN / PATH_BLOCK_N * PATH_BLOCK_N; first < end;
+       first += batch->chunkPathN, taskN++) {
+    const int target =
+        deviceN > 1 ? (taskFirst + taskN) % deviceN : device;
+    batch->scheduler->push(target, {option, first / PATH_BLOCK_N, level});
+  }
+
+  batch->h_LevelPathN[row] = end;
+  return taskN;
+}
+
+void initMlmcOption(TBatchPlan *batch, int option, int device) {
+  const int levelN = std::min(MLMC_START_LEVEL_N, batch->levelN);
+
+  batch->h_LevelN[option] = levelN;
+  for (int l = 0; l < levelN; l++)
+    extendLevel(batch, option, l, MLMC_PILOT_PATH_N, device, 1, 0);
+}
+
+void reduceMlmcOption(TBatchPlan *batch, int option, TOptionValue &value) {
+  const int L = batch->h_LevelN[option];
+  const double RT = batch->options->DiscountRT[option];
+  double mean = 0, var = 0, cost = 0;
+  long long pathN = 0;
+  TBlockMoments finest = TBlockMoments();
+
+  for (int l = 0; l < L; l++) {
+    finest = levelMoments(batch, option, l);
+    mean += finest.mean[MOMENT_PAYOFF];
+    if (finest.n > 0) var += levelVariance(finest) / finest.n;
+    cost += finest.n * levelCost(batch, l);
+    pathN += (long long)finest.n;
+  }
+
+  value = TOptionValue();
+  value.Expected = (real)(RT * mean);
+  value.Confidence = (real)(RT * 1.96 * sqrt(var));
+  batch->h_PathN[option] = (int)std::min<long long>(pathN, INT_MAX);
+
+  // Single-level sampling on the finest grid needs V[P] / var paths of
+  // levelStepN steps for the same variance
+  const double varFine =
+      finest.n > 1 ? finest.m2[MOMENT_CONTROL] / (finest.n - 1) : 0;
+  batch->h_VarianceRatio[option] =
+      var > 0 && cost > 0
+          ? (real)(varFine / var * levelStepN(*batch, L - 1) / cost)
+          : 0;
+}
+
+int scheduleMlmcOption(TBatchPlan *batch, int option, int deviceN,
+                       int taskFirst) {
+  const int L = batch->h_LevelN[option];
+  const double eps =
+      batch->options->Tolerance[option] / batch->options->DiscountRT[option];
+  std::vector<double> V(L);
+  double sumVC = 0;
+  int taskN = 0;
+
+  for (int l = 0; l < L; l++) {
+    V[l] = levelVariance(levelMoments(batch, option, l));
+    sumVC += sqrt(V[l] * levelCost(batch, l));
+  }
+
+  for (int l = 0; l < L; l++) {
+    const double pathN =
+        2 / (eps * eps) * sqrt(V[l] / levelCost(batch, l)) * sumVC;
+    taskN += extendLevel(batch, option, l, pathN, 0, deviceN,
+                         taskFirst + taskN);
+  }
+  if (taskN > 0) return taskN;
+
+  // Variance target met or budget spent: refine the grid while the bias is
+  // too large
+  if (L == batch->levelN || levelBias(batch, option) <= eps / sqrt(2.0))
+    return 0;
+  batch->h_LevelN[option] = L + 1;
+  return extendLevel(batch, option, L, MLMC_PILOT_PATH_N, 0, deviceN,
+                     taskFirst);
+}
+
+bool mlmcConverged(const TBatchPlan *batch, int option) {
+  const double RT = batch->options->DiscountRT[option];
+  const double eps = batch->options->Tolerance[option];
+  const double sd = batch->callValue[option].Confidence / 1.96;
+  const double bias = RT * levelBias(batch, option);
+  return sd * sd <= eps * eps / 2 && bias * bias <= eps * eps / 2;
+}
@@ -0,0 +1,64 @@
+#ifndef MONTECARLO_MLMC_H
+#define MONTECARLO_MLMC_H
+
+#include <cstdint>
+
+#include "MonteCarlo_common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Multilevel Monte Carlo (Giles, "Multilevel Monte Carlo path simulation").
+// Level l of an option simulates paths on a grid of stepN 2^l steps; each
+// path of level l > 0 is also monitored on the coarse grid of level l - 1,
+// and the level's sample is the difference of the two payoffs. The level
+// means telescope to the payoff in the continuous-monitoring limit, and
+// because coupled payoffs differ little, the fine levels need few paths.
+//
+// Every level is a row of its own in the batch's path block moments, so
+// levels are scheduled as independent tasks. After each round the variance
+// V_l of every level is estimated and level l is extended to
+//   N_l = 2 / eps^2 sqrt(V_l / C_l) sum_k sqrt(V_k C_k)
+// paths, C_l being its steps per path, which puts the estimator's variance
+// at eps^2 / 2. Once no level needs more paths, a new level is added while
+// the bias estimated from the finest level means exceeds eps / sqrt(2).
+// eps is the option's Tolerance, as a root-mean-square error.
+////////////////////////////////////////////////////////////////////////////////
+
+// Levels an option starts with, and paths per level of the first round
+const int MLMC_START_LEVEL_N = 3;
+const int MLMC_PILOT_PATH_N = 1024;
+// Levels are numbered in the top bits of the Philox stream id
+const int MLMC_STREAM_SHIFT = 24;
+
+// Fine steps per path of level l
+inline int levelStepN(const TBatchPlan &batch, int level) {
+  return batch.stepN << level;
+}
+
+// Philox stream of fine step k of level l. Level 0 draws the same normals
+// as a single-level run.
+inline uint32_t levelStream(int level, int k) {
+  return (uint32_t)level << MLMC_STREAM_SHIFT | (uint32_t)k;
+}
+
+// Row of (option, level) in h_BlockMoments and h_LevelPathN
+inline int levelRow(const TBatchPlan &batch, int option, int level) {
+  return option * batch.levelN + level;
+}
+
+// Queue the pilot paths of an option's first levels on device
+void initMlmcOption(TBatchPlan *batch, int option, int device);
+
+// Combine the level moments of an option into its value. Confidence is the
+// 95% width of the statistical error alone.
+void reduceMlmcOption(TBatchPlan *batch, int option, TOptionValue &value);
+
+// Queue the next round of an option's levels, dealing tasks round-robin to
+// deviceN devices starting at task taskFirst. Returns the tasks queued.
+int scheduleMlmcOption(TBatchPlan *batch, int option, int deviceN,
+                       int taskFirst);
+
+// Whether an option has met its root-mean-square error target: variance and
+// estimated squared bias each within Tolerance^2 / 2
+bool mlmcConverged(const TBatchPlan *batch, int option);
+
+#endif
@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+// Scalar normal generator and runtime code path selection
+////////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+#include <cstring>
+
+#include "MonteCarlo_normal.h"
+
+using namespace normal_const;
+
+static inline uint32_t floatBits(float x) {
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  return bits;
+}
+
+static inline float bitsFloat(uint32_t bits) {
+  float x;
+  memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+// Natural log of x in (0, 1]
+static inline float logScalar(float x) {
+  uint32_t bits = floatBits(x);
+  float e = (float)((int32_t)(bits >> 23) - 126);
+  float m = bitsFloat((bits & 0x807FFFFF) | 0x3F000000);
+
+  bool small = m < SQRTHF;
+  x = (m - 1.0f) + (small ? m : 0.0f);
+  e = e - (small ? 1.0f : 0.0f);
+
+  float z = x * x;
+  float y = LOG_P0;
+  y = y * x + LOG_P1;
+  y = y * x + LOG_P2;
+  y = y * x + LOG_P3;
+  y = y * x + LOG_P4;
+  y = y * x + LOG_P5;
+  y = y * x + LOG_P6;
+  y = y * x + LOG_P7;
+  y = y * x + LOG_P8;
+  y = y * x * z;
+  y = y + LOG_Q1 * e;
+  y = y - 0.5f * z;
+  x = x + y;
+  return x + LOG_Q2 * e;
+}
+
+// sin and cos of 2 * pi * u for u in [0, 1)
+static inline void sinCos2PiScalar(float u, float &s, float &c) {
+  float q = nearbyintf(u * 4.0f);
+  float t = (u - q * 0.25f) * TWO_PI;
+  float z = t * t;
+
+  float sp = ((SIN_P0 * z + SIN_P1) * z + SIN_P2) * z * t + t;
+  float cp = ((COS_P0 * z + COS_P1) * z + COS_P2) * z * z - 0.5f * z + 1.0f;
+
+  int j = (int)q & 3;
+  s = (j & 1) ? cp : sp;
+  c = (j & 1) ? sp : cp;
+  if (j & 2) s = -s;
+  if ((j + 1) & 2) c = -c;
+}
+
+static inline void boxMullerScalar(uint32_t a, uint32_t b, float &z0,
+                                   float &z1) {
+  float u1 = (float)((a >> 8) + 1) * INV_2_24;
+  float u2 = (float)(b >> 8) * INV_2_24;
+  float r = sqrtf(-2.0f * logScalar(u1));
+  float s, c;
+  sinCos2PiScalar(u2, s, c);
+  z0 = r * c;
+  z1 = r * s;
+}
+
+void normalsScalar(float *z, uint64_t blockFirst, int blockN, TPhiloxKey key,
+                   uint32_t option, uint32_t stream) {
+  for (int i = 0; i < blockN; i++) {
+    uint64_t block = blockFirst + i;
+    TPhiloxCounter c = {{(uint32_t)block, (uint32_t)(block >> 32), option,
+                         stream}};
+    TPhiloxCounter bits = philox4x32_10(c, key);
+    boxMullerScalar(bits.v[0], bits.v[1], z[4 * i + 0], z[4 * i + 1]);
+    boxMullerScalar(bits.v[2], bits.v[3], z[4 * i + 2], z[4 * i + 3]);
+  }
+}
+
+TNormalGenerator normalGenerator = normalsScalar;
+
+double inverseNormalCDF(double p) {
+  static const double a[6] = {-3.969683028665376e+01, 2.209460984245205e+02,
+                              -2.759285104469687e+02, 1.383577518672690e+02,
+                              -3.066479806614716e+01, 2.506628277459239e+00};
+  static const double b[5] = {-5.447609879822406e+01, 1.615858368580409e+02,
+                              -1.556989798598866e+02, 6.680131188771972e+01,
+                              -1.328068155288572e+01};
+  static const double c[6] = {-7.784894002430293e-03, -3.223964580411365e-01,
+                              -2.400758277161838e+00, -2.549732539343734e+00,
+                              4.374664141464968e+00, 2.938163982698783e+00};
+  static const double d[4] = {7.784695709041462e-03, 3.224671290700398e-01,
+                              2.445134137142996e+00, 3.754408661907416e+00};
+  const double P_LOW = 0.02425;
+  double x;
+
+  if (p < P_LOW) {
+    double q = sqrt(-2 * log(p));
+    x = (((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q + c[5]) /
+        ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+  } else if (p <= 1 - P_LOW) {
+    double q = p - 0.5;
+    double r = q * q;
+    x = (((((a[0] * r + a[1]) * r + a[2]) * r + a[3]) * r + a[4]) * r + a[5]) *
+        q /
+        (((((b[0] * r + b[1]) * r + b[2]) * r + b[3]) * r + b[4]) * r + 1);
+  } else {
+    double q = sqrt(-2 * log(1 - p));
+    x = -(((((c[0] * q + c[1]) * q + c[2]) * q + c[3]) * q + c[4]) * q +
+          c[5]) /
+        ((((d[0] * q + d[1]) * q + d[2]) * q + d[3]) * q + 1);
+  }
+
+  return x;
+}
+
+TNormalGenerator getNormalGenerator(const char *name, const char **selected) {
+  bool any = !name || !*name || strcmp(name, "auto") == 0;
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  __builtin_cpu_init();
+
+  if ((any || strcmp(name, "avx512") == 0) &&
+      __builtin_cpu_supports("avx512f")) {
+    if (selected) *selected = "avx512";
+    return normalsAVX512;
+  }
+
+  if ((any || strcmp(name, "avx2") == 0) && __builtin_cpu_supports("avx2")) {
+    if (selected) *selected = "avx2";
+    return normalsAVX2;
+  }
+#endif
+
+  if (any || strcmp(name, "scalar") == 0) {
+    if (selected) *selected = "scalar";
+    return normalsScalar;
+  }
+
+  return NULL;
+}
@@ -0,0 +1,75 @@
+#ifndef MONTECARLO_NORMAL_H
+#define MONTECARLO_NORMAL_H
+
+#include <cstdint>
+
+#include "MonteCarlo_philox.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Block normal generators. A generator fills z[0 .. 4 * blockN) with the
+// N(0,1) samples of Philox blocks [blockFirst, blockFirst + blockN) of stream
+// (option, stream): block b yields samples 4b .. 4b + 3 by Box-Muller on its
+// two pairs of 32-bit outputs.
+//
+// Every code path evaluates the same float polynomials for log, sin and cos
+// in the same operation order without contraction, so the scalar, AVX2 and
+// AVX-512 generators produce bit-identical samples.
+////////////////////////////////////////////////////////////////////////////////
+typedef void (*TNormalGenerator)(float *z, uint64_t blockFirst, int blockN,
+                                 TPhiloxKey key, uint32_t option,
+                                 uint32_t stream);
+
+void normalsScalar(float *z, uint64_t blockFirst, int blockN, TPhiloxKey key,
+                   uint32_t option, uint32_t stream);
+void normalsAVX2(float *z, uint64_t blockFirst, int blockN, TPhiloxKey key,
+                 uint32_t option, uint32_t stream);
+void normalsAVX512(float *z, uint64_t blockFirst, int blockN, TPhiloxKey key,
+                   uint32_t option, uint32_t stream);
+
+// Look up a generator by name ("scalar", "avx2", "avx512"); NULL or "auto"
+// picks the widest one the host supports. Returns NULL if the requested code
+// path is unknown or not supported by the host.
+TNormalGenerator getNormalGenerator(const char *name, const char **selected);
+
+// Generator used by the pricing kernels
+extern TNormalGenerator normalGenerator;
+
+// Inverse of the standard normal CDF for p in (0, 1) by Acklam's rational
+// approximation (relative error below 1.2e-9, far inside float resolution).
+// Quasi-random points must be mapped to normals one coordinate at a time,
+// which rules out Box-Muller.
+double inverseNormalCDF(double p);
+
+////////////////////////////////////////////////////////////////////////////////
+// Constants shared by all code paths
+////////////////////////////////////////////////////////////////////////////////
+namespace normal_const {
+// 2^-24: 32-bit outputs are reduced to their top 24 bits, which convert to
+// float exactly
+const float INV_2_24 = 5.9604644775390625e-8f;
+const float TWO_PI = 6.28318530717958647692f;
+const float SQRTHF = 0.707106781186547524f;
+
+// Cephes logf
+const float LOG_P0 = 7.0376836292E-2f;
+const float LOG_P1 = -1.1514610310E-1f;
+const float LOG_P2 = 1.1676998740E-1f;
+const float LOG_P3 = -1.2420140846E-1f;
+const float LOG_P4 = 1.4249322787E-1f;
+const float LOG_P5 = -1.6668057665E-1f;
+const float LOG_P6 = 2.0000714765E-1f;
+const float LOG_P7 = -2.4999993993E-1f;
+const float LOG_P8 = 3.3333331174E-1f;
+const float LOG_Q1 = -2.12194440e-4f;
+const float LOG_Q2 = 0.693359375f;
+
+// Cephes sinf / cosf on [-pi/4, pi/4]
+const float SIN_P0 = -1.9515295891E-4f;
+const float SIN_P1 = 8.3321608736E-3f;
+const float SIN_P2 = -1.6666654611E-1f;
+const float COS_P0 = 2.443315711809948E-005f;
+const float COS_P1 = -1.388731625493765E-003f;
+const float COS_P2 = 4.166664568298827E-002f;
+}  // namespace normal_const
+
+#endif
@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+// AVX2 normal generator: eight Philox blocks per iteration, one per 32-bit
+// lane, followed by a vectorised Box-Muller transform. Compiled with -mavx2
+// and without FMA contraction so it matches the scalar generator bit for bit.
+////////////////////////////////////////////////////////////////////////////////
+#include "MonteCarlo_normal.h"
+
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+using namespace normal_const;
+
+static inline void mulHiLo(__m256i a, __m256i b, __m256i &hi, __m256i &lo) {
+  __m256i even = _mm256_mul_epu32(a, b);
+  __m256i odd =
+      _mm256_mul_epu32(_mm256_srli_epi64(a, 32), _mm256_srli_epi64(b, 32));
+  lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+  hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+}
+
+static inline void philox8(__m256i c[4], TPhiloxKey key) {
+  const __m256i M0 = _mm256_set1_epi32((int)0xD2511F53);
+  const __m256i M1 = _mm256_set1_epi32((int)0xCD9E8D57);
+  uint32_t k0 = key.v[0], k1 = key.v[1];
+
+  for (int round = 0; round < 10; round++) {
+    __m256i hi0, lo0, hi1, lo1;
+    mulHiLo(M0, c[0], hi0, lo0);
+    mulHiLo(M1, c[2], hi1, lo1);
+
+    c[0] = _mm256_xor_si256(_mm256_xor_si256(hi1, c[1]),
+                            _mm256_set1_epi32((int)k0));
+    c[1] = lo1;
+    c[2] = _mm256_xor_si256(_mm256_xor_si256(hi0, c[3]),
+                            _mm256_set1_epi32((int)k1));
+    c[3] = lo0;
+    k0 += 0x9E3779B9;
+    k1 += 0xBB67AE85;
+  }
+}
+
+static inline __m256 log8(__m256 x) {
+  const __m256 one = _mm256_set1_ps(1.0f);
+  __m256i bits = _mm256_castps_si256(x);
+  __m256 e = _mm256_cvtepi32_ps(
+      _mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(126)));
+  __m256 m = _mm256_castsi256_ps(
+      _mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x807FFFFF)),
+                      _mm256_set1_epi32(0x3F000000)));
+
+  __m256 small = _mm256_cmp_ps(m, _mm256_set1_ps(SQRTHF), _CMP_LT_OQ);
+  x = _mm256_add_ps(_mm256_sub_ps(m, one), _mm256_and_ps(small, m));
+  e = _mm256_sub_ps(e, _mm256_and_ps(small, one));
+
+  __m256 z = _mm256_mul_ps(x, x);
+  __m256 y = _mm256_set1_ps(LOG_P0);
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P1));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P2));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P3));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P4));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P5));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P6));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P7));
+  y = _mm256_add_ps(_mm256_mul_ps(y, x), _mm256_set1_ps(LOG_P8));
+  y = _mm256_mul_ps(_mm256_mul_ps(y, x), z);
+  y = _mm256_add_ps(y, _mm256_mul_ps(_mm256_set1_ps(LOG_Q1), e));
+  y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_set1_ps(0.5f), z));
+  x = _mm256_add_ps(x, y);
+  return _mm256_add_ps(x, _mm256_mul_ps(_mm256_set1_ps(LOG_Q2), e));
+}
+
+static inline void sinCos2Pi8(__m256 u, __m256 &s, __m256 &c) {
+  const __m256 signMask = _mm256_set1_ps(-0.0f);
+  __m256 q = _mm256_round_ps(_mm256_mul_ps(u, _mm256_set1_ps(4.0f)),
+                             _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m256 t = _mm256_mul_ps(
+      _mm256_sub_ps(u, _mm256_mul_ps(q, _mm256_set1_ps(0.25f))),
+      _mm256_set1_ps(TWO_PI));
+  __m256 z = _mm256_mul_ps(t, t);
+
+  __m256 sp = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SIN_P0), z),
+                            _mm256_set1_ps(SIN_P1));
+  sp = _mm256_add_ps(_mm256_mul_ps(sp, z), _mm256_set1_ps(SIN_P2));
+  sp = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sp, z), t), t);
+
+  __m256 cp = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(COS_P0), z),
+                            _mm256_set1_ps(COS_P1));
+  cp = _mm256_add_ps(_mm256_mul_ps(cp, z), _mm256_set1_ps(COS_P2));
+  cp = _mm256_mul_ps(_mm256_mul_ps(cp, z), z);
+  cp = _mm256_sub_ps(cp, _mm256_mul_ps(_mm256_set1_ps(0.5f), z));
+  cp = _mm256_add_ps(cp, _mm256_set1_ps(1.0f));
+
+  __m256i j = _mm256_cvtps_epi32(q);
+  __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(
+      _mm256_and_si256(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(1)));
+  __m256 sinNeg = _mm256_castsi256_ps(
+      _mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), 30));
+  __m256 cosNeg = _mm256_castsi256_ps(_mm256_slli_epi32(
+      _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)),
+                       _mm256_set1_epi32(2)),
+      30));
+
+  s = _mm256_xor_ps(_mm256_blendv_ps(sp, cp, swap),
+                    _mm256_and_ps(sinNeg, signMask));
+  c = _mm256_xor_ps(_mm256_blendv_ps(cp, sp, swap),
+                    _mm256_and_ps(cosNeg, signMask));
+}
+
+static inline void boxMuller8(__m256i a, __m256i b, __m256 &z0, __m256 &z1) {
+  const __m256 scale = _mm256_set1_ps(INV_2_24);
+  __m256 u1 = _mm256_mul_ps(
+      _mm256_cvtepi32_ps(
+          _mm256_add_epi32(_mm256_srli_epi32(a, 8), _mm256_set1_epi32(1))),
+      scale);
+  __m256 u2 = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(b, 8)), scale);
+  __m256 r =
+      _mm256_sqrt_ps(_mm256_mul_ps(_mm256_set1_ps(-2.0f), log8(u1)));
+  __m256 s, c;
+  sinCos2Pi8(u2, s, c);
+  z0 = _mm256_mul_ps(r, c);
+  z1 = _mm256_mul_ps(r, s);
+}
+
+void normalsAVX2(float *z, uint64_t blockFirst, int blockN, TPhiloxKey key,
+                 uint32_t option, uint32_t stream) {
+  int i = 0;
+
+  for (; i + 8 <= blockN; i += 8) {
+    alignas(32) uint32_t lo[8], hi[8];
+    for (int k = 0; k < 8; k++) {
+      uint64_t block = blockFirst + i + k;
+      lo[k] = (uint32_t)block;
+      hi[k] = (uint32_t)(block >> 32);
+    }
+
+    __m256i c[4] = {_mm256_load_si256((const __m256i *)lo),
+                    _mm256_load_si256((const __m256i *)hi),
+                    _mm256_set1_epi32((int)option),
+                    _mm256_set1_epi32((int)stream)};
+    philox8(c, key);
+
+    // a, b: samples 4k, 4k + 1; d, e: samples 4k + 2, 4k + 3
+    __m256 a, b, d, e;
+    boxMuller8(c[0], c[1], a, b);
+    boxMuller8(c[2], c[3], d, e);
+
+    // Transpose the four 8-lane vectors into sample order
+    __m256 t0 = _mm256_unpacklo_ps(a, b);
+    __m256 t1 = _mm256_unpackhi_ps(a, b);
+    __m256 t2 = _mm256_unpacklo_ps(d, e);
+    __m256 t3 = _mm256_unpackhi_ps(d, e);
+    __m256 u0 = _mm256_shuffle_ps(t0, t2, 0x44);
+    __m256 u1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+    __m256 u2 = _mm256_shuffle_ps(t1, t3, 0x44);
+    __m256 u3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+
+    float *out = z + 4 * i;
+    _mm256_storeu_ps(out + 0, _mm256_permute2f128_ps(u0, u1, 0x20));
+    _mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(u2, u3, 0x20));
+    _mm256_storeu_ps(out + 16, _mm256_permute2f128_ps(u0, u1, 0x31));
+    _mm256_storeu_ps(out + 24, _mm256_permute2f128_ps(u2, u3, 0x31));
+  }
+
+  if (i < blockN)
+    normalsScalar(z + 4 * i, blockFirst + i, blockN - i, key, option, stream);
+}
+
+#else
+
+void normalsAVX2(float *z, uint64_t blockFirst, int blockN, TPhiloxKey key,
+                 uint32_t option, uint32_t stream) {
+  normalsScalar(z, blockFirst, blockN, key, option, stream);
+}
+
+#endif
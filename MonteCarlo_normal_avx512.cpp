@@ -0,0 +1,182 @@
+////////////////////////////////////////////////////////////////////////////////
+// AVX-512 normal generator: sixteen Philox blocks per iteration, one per
+// 32-bit lane, followed by a vectorised Box-Muller transform. Compiled with
+// -mavx512f and without FMA contraction so it matches the scalar generator
+// bit for bit.
+////////////////////////////////////////////////////////////////////////////////
+#include "MonteCarlo_normal.h"
+
+#ifdef __AVX512F__
+
+#include <immintrin.h>
+
+using namespace normal_const;
+
+static inline void mulHiLo(__m512i a, __m512i b, __m512i &hi, __m512i &lo) {
+  __m512i even = _mm512_mul_epu32(a, b);
+  __m512i odd =
+      _mm512_mul_epu32(_mm512_srli_epi64(a, 32), _mm512_srli_epi64(b, 32));
+  lo = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+  hi = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+}
+
+static inline void philox16(__m512i c[4], TPhiloxKey key) {
+  const __m512i M0 = _mm512_set1_epi32((int)0xD2511F53);
+  const __m512i M1 = _mm512_set1_epi32((int)0xCD9E8D57);
+  uint32_t k0 = key.v[0], k1 = key.v[1];
+
+  for (int round = 0; round < 10; round++) {
+    __m512i hi0, lo0, hi1, lo1;
+    mulHiLo(M0, c[0], hi0, lo0);
+    mulHiLo(M1, c[2], hi1, lo1);
+
+    c[0] = _mm512_xor_si512(_mm512_xor_si512(hi1, c[1]),
+                            _mm512_set1_epi32((int)k0));
+    c[1] = lo1;
+    c[2] = _mm512_xor_si512(_mm512_xor_si512(hi0, c[3]),
+                            _mm512_set1_epi32((int)k1));
+    c[3] = lo0;
+    k0 += 0x9E3779B9;
+    k1 += 0xBB67AE85;
+  }
+}
+
+static inline __m512 log16(__m512 x) {
+  const __m512 one = _mm512_set1_ps(1.0f);
+  __m512i bits = _mm512_castps_si512(x);
+  __m512 e = _mm512_cvtepi32_ps(
+      _mm512_sub_epi32(_mm512_srli_epi32(bits, 23), _mm512_set1_epi32(126)));
+  __m512 m = _mm512_castsi512_ps(
+      _mm512_or_si512(_mm512_and_si512(bits, _mm512_set1_epi32(0x807FFFFF)),
+                      _mm512_set1_epi32(0x3F000000)));
+
+  __mmask16 small = _mm512_cmp_ps_mask(m, _mm512_set1_ps(SQRTHF), _CMP_LT_OQ);
+  x = _mm512_add_ps(_mm512_sub_ps(m, one),
+                    _mm512_maskz_mov_ps(small, m));
+  e = _mm512_sub_ps(e, _mm512_maskz_mov_ps(small, one));
+
+  __m512 z = _mm512_mul_ps(x, x);
+  __m512 y = _mm512_set1_ps(LOG_P0);
+  y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(LOG_P1));
+  y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(LOG_P2));
+  y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(LOG_P3));
+  y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(LOG_P4));
+  y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(LOG_P5));
+  y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(LOG_P6));
+  y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(LOG_P7));
+  y = _mm512_add_ps(_mm512_mul_ps(y, x), _mm512_set1_ps(LOG_P8));
+  y = _mm512_mul_ps(_mm512_mul_ps(y, x), z);
+  y = _mm512_add_ps(y, _mm512_mul_ps(_mm512_set1_ps(LOG_Q1), e));
+  y = _mm512_sub_ps(y, _mm512_mul_ps(_mm512_set1_ps(0.5f), z));
+  x = _mm512_add_ps(x, y);
+  return _mm512_add_ps(x, _mm512_mul_ps(_mm512_set1_ps(LOG_Q2), e));
+}
+
+static inline void sinCos2Pi16(__m512 u, __m512 &s, __m512 &c) {
+  __m512 q = _mm512_roundscale_ps(_mm512_mul_ps(u, _mm512_set1_ps(4.0f)),
+                                  _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  __m512 t = _mm512_mul_ps(
+      _mm512_sub_ps(u, _mm512_mul_ps(q, _mm512_set1_ps(0.25f))),
+      _mm512_set1_ps(TWO_PI));
+  __m512 z = _mm512_mul_ps(t, t);
+
+  __m512 sp = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(SIN_P0), z),
+                            _mm512_set1_ps(SIN_P1));
+  sp = _mm512_add_ps(_mm512_mul_ps(sp, z), _mm512_set1_ps(SIN_P2));
+  sp = _mm512_add_ps(_mm512_mul_ps(_mm512_mul_ps(sp, z), t), t);
+
+  __m512 cp = _mm512_add_ps(_mm512_mul_ps(_mm512_set1_ps(COS_P0), z),
+                            _mm512_set1_ps(COS_P1));
+  cp = _mm512_add_ps(_mm512_mul_ps(cp, z), _mm512_set1_ps(COS_P2));
+  cp = _mm512_mul_ps(_mm512_mul_ps(cp, z), z);
+  cp = _mm512_sub_ps(cp, _mm512_mul_ps(_mm512_set1_ps(0.5f), z));
+  cp = _mm512_add_ps(cp, _mm512_set1_ps(1.0f));
+
+  __m512i j = _mm512_cvtps_epi32(q);
+  __mmask16 swap =
+      _mm512_test_epi32_mask(j, _mm512_set1_epi32(1));
+  __m512i sinNeg =
+      _mm512_slli_epi32(_mm512_and_si512(j, _mm512_set1_epi32(2)), 30);
+  __m512i cosNeg = _mm512_slli_epi32(
+      _mm512_and_si512(_mm512_add_epi32(j, _mm512_set1_epi32(1)),
+                       _mm512_set1_epi32(2)),
+      30);
+
+  s = _mm512_castsi512_ps(_mm512_xor_si512(
+      _mm512_castps_si512(_mm512_mask_blend_ps(swap, sp, cp)), sinNeg));
+  c = _mm512_castsi512_ps(_mm512_xor_si512(
+      _mm512_castps_si512(_mm512_mask_blend_ps(swap, cp, sp)), cosNeg));
+}
+
+static inline void boxMuller16(__m512i a, __m512i b, __m512 &z0,
+                               __m512 &z1) {
+  const __m512 scale = _mm512_set1_ps(INV_2_24);
+  __m512 u1 = _mm512_mul_ps(
+      _mm512_cvtepi32_ps(
+          _mm512_add_epi32(_mm512_srli_epi32(a, 8), _mm512_set1_epi32(1))),
+      scale);
+  __m512 u2 = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srli_epi32(b, 8)), scale);
+  __m512 r =
+      _mm512_sqrt_ps(_mm512_mul_ps(_mm512_set1_ps(-2.0f), log16(u1)));
+  __m512 s, c;
+  sinCos2Pi16(u2, s, c);
+  z0 = _mm512_mul_ps(r, c);
+  z1 = _mm512_mul_ps(r, s);
+}
+
+void normalsAVX512(float *z, uint64_t blockFirst, int blockN, TPhiloxKey key,
+                   uint32_t option, uint32_t stream) {
+  // Lane k of the interleave inputs lands at sample 4k + input index
+  const __m512i ab = _mm512_set_epi32(23, 7, 22, 6, 21, 5, 20, 4,
+                                      19, 3, 18, 2, 17, 1, 16, 0);
+  const __m512i abHi = _mm512_set_epi32(31, 15, 30, 14, 29, 13, 28, 12,
+                                        27, 11, 26, 10, 25, 9, 24, 8);
+  const __m512i quadLo = _mm512_set_epi32(23, 22, 7, 6, 21, 20, 5, 4,
+                                          19, 18, 3, 2, 17, 16, 1, 0);
+  const __m512i quadHi = _mm512_set_epi32(31, 30, 15, 14, 29, 28, 13, 12,
+                                          27, 26, 11, 10, 25, 24, 9, 8);
+  int i = 0;
+
+  for (; i + 16 <= blockN; i += 16) {
+    alignas(64) uint32_t lo[16], hi[16];
+    for (int k = 0; k < 16; k++) {
+      uint64_t block = blockFirst + i + k;
+      lo[k] = (uint32_t)block;
+      hi[k] = (uint32_t)(block >> 32);
+    }
+
+    __m512i c[4] = {_mm512_load_si512(lo), _mm512_load_si512(hi),
+                    _mm512_set1_epi32((int)option),
+                    _mm512_set1_epi32((int)stream)};
+    philox16(c, key);
+
+    // a, b: samples 4k, 4k + 1; d, e: samples 4k + 2, 4k + 3
+    __m512 a, b, d, e;
+    boxMuller16(c[0], c[1], a, b);
+    boxMuller16(c[2], c[3], d, e);
+
+    // Interleave pairs (a, b) and (d, e), then pairs of pairs
+    __m512 abLo = _mm512_permutex2var_ps(a, ab, b);
+    __m512 abHi2 = _mm512_permutex2var_ps(a, abHi, b);
+    __m512 deLo = _mm512_permutex2var_ps(d, ab, e);
+    __m512 deHi = _mm512_permutex2var_ps(d, abHi, e);
+
+    float *out = z + 4 * i;
+    _mm512_storeu_ps(out + 0, _mm512_permutex2var_ps(abLo, quadLo, deLo));
+    _mm512_storeu_ps(out + 16, _mm512_permutex2var_ps(abLo, quadHi, deLo));
+    _mm512_storeu_ps(out + 32, _mm512_permutex2var_ps(abHi2, quadLo, deHi));
+    _mm512_storeu_ps(out + 48, _mm512_permutex2var_ps(abHi2, quadHi, deHi));
+  }
+
+  if (i < blockN)
+    normalsScalar(z + 4 * i, blockFirst + i, blockN - i, key, option, stream);
+}
+
+#else
+
+void normalsAVX512(float *z, uint64_t blockFirst, int blockN, TPhiloxKey key,
+                   uint32_t option, uint32_t stream) {
+  normalsScalar(z, blockFirst, blockN, key, option, stream);
+}
+
+#endif
@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+// Conversion of array-of-structs option data into the SoA batch layout
+////////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "MonteCarlo_common.h"
+
+template <class T>
+static T *allocColumn(int n) {
+  size_t bytes = ((n * sizeof(T) + 63) / 64) * 64;
+  T *column = (T *)aligned_alloc(64, bytes);
+  memset(column, 0, bytes);
+  return column;
+}
+
+void initOptionBatch(TOptionBatch *batch, const TOptionData *optionData,
+                     int optionN) {
+  const int paddedN = (optionN + OPTION_LANES - 1) / OPTION_LANES * OPTION_LANES;
+
+  batch->optionN = optionN;
+  batch->S = allocColumn<real>(paddedN);
+  batch->X = allocColumn<real>(paddedN);
+  batch->T = allocColumn<real>(paddedN);
+  batch->R = allocColumn<real>(paddedN);
+  batch->V = allocColumn<real>(paddedN);
+  batch->MuByT = allocColumn<real>(paddedN);
+  batch->VBySqrtT = allocColumn<real>(paddedN);
+  batch->DiscountRT = allocColumn<real>(paddedN);
+  batch->Tolerance = allocColumn<real>(paddedN);
+  batch->Payoff = allocColumn<int>(paddedN);
+  batch->Barrier = allocColumn<real>(paddedN);
+  batch->Basket = allocColumn<int>(paddedN);
+  batch->baskets = NULL;
+  batch->Model = allocColumn<int>(paddedN);
+  batch->heston = NULL;
+  batch->merton = NULL;
+  batch->Surface = allocColumn<int>(paddedN);
+  batch->surfaces = NULL;
+
+  for (int i = 0; i < optionN; i++) {
+    const TOptionData &option = optionData[i];
+    const double T = option.T, R = option.R, V = option.V;
+
+    batch->S[i] = option.S;
+    batch->X[i] = option.X;
+    batch->T[i] = option.T;
+    batch->R[i] = option.R;
+    batch->V[i] = option.V;
+    batch->MuByT[i] = (real)((R - 0.5 * V * V) * T);
+    batch->VBySqrtT[i] = (real)(V * sqrt(T));
+    batch->DiscountRT[i] = (real)exp(-R * T);
+  }
+}
+
+void closeOptionBatch(TOptionBatch *batch) {
+  free(batch->S);
+  free(batch->X);
+  free(batch->T);
+  free(batch->R);
+  free(batch->V);
+  free(batch->MuByT);
+  free(batch->VBySqrtT);
+  free(batch->DiscountRT);
+  free(batch->Tolerance);
+  free(batch->Payoff);
+  free(batch->Barrier);
+  free(batch->Basket);
+  free(batch->Model);
+  free(batch->Surface);
+}
@@ -0,0 +1,634 @@
+////////////////////////////////////////////////////////////////////////////////
+// Multi-step GBM path engine
+////////////////////////////////////////////////////////////////////////////////
+#include <cmath>
+#include <vector>
+
+#include "MonteCarlo_basket.h"
+#include "MonteCarlo_heston.h"
+#include "MonteCarlo_localvol.h"
+#include "MonteCarlo_merton.h"
+#include "MonteCarlo_mlmc.h"
+#include "MonteCarlo_normal.h"
+#include "MonteCarlo_path.h"
+#include "MonteCarlo_sobol.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Per-path payoff state, updated on the fly. begin() sees the spot, step() the
+// log-return x = log(S / S0) and price after every time step, end() the
+// terminal price. control() is the raw control variate sample of the path:
+// the terminal price, or the geometric Asian payoff for arithmetic Asians.
+//
+// With Greeks, stepGreeks() runs before step() with the derivatives dlogS of
+// log S(t_k) with respect to the spot, volatility and rate (1 / S0,
+// W(t_k) - V t_k and t_k), and endGreeks() writes the pathwise derivatives
+// of the undiscounted payoff. The digital call, whose payoff jumps, uses
+// likelihood-ratio weights instead.
+////////////////////////////////////////////////////////////////////////////////
+struct CallState {
+  real X;
+  real dlogS[GREEK_N][PATH_TILE_N];
+  void begin(int, real) {}
+  void step(int, real, real) {}
+  real end(int, real S) const { return S > X ? S - X : 0; }
+  real control(int, real S) const { return S; }
+  void stepGreeks(int i, real, real, const real *d) {
+    for (int g = 0; g < GREEK_N; g++) dlogS[g][i] = d[g];
+  }
+  void endGreeks(int i, real S, real *greeks) const {
+    for (int g = 0; g < GREEK_N; g++)
+      greeks[g] = S > X ? S * dlogS[g][i] : 0;
+  }
+};
+
+struct DigitalCallState {
+  real X, S0, V, T;
+  real dlogV[PATH_TILE_N];
+  void begin(int, real) {}
+  void step(int, real, real) {}
+  real end(int, real S) const { return S > X ? 1 : 0; }
+  real control(int, real S) const { return S; }
+  void stepGreeks(int i, real, real, const real *d) {
+    dlogV[i] = d[GREEK_VEGA];
+  }
+  // Score of the terminal density in W(T) = dlog S / dV + V T
+  void endGreeks(int i, real S, real *greeks) const {
+    const real W = dlogV[i] + V * T;
+    const real y = end(i, S);
+    greeks[GREEK_DELTA] = y * W / (S0 * V * T);
+    greeks[GREEK_VEGA] = y * ((W * W / T - 1) / V - W);
+    greeks[GREEK_RHO] = y * W / V;
+  }
+};
+
+// Multilevel runs target continuous monitoring and scale the discrete
+// maximum by the Broadie-Glasserman-Kou factor exp(0.5826 V sqrt(dt)),
+// which removes its O(sqrt(dt)) bias; single-level runs keep maxScale = 1.
+struct LookbackCallState {
+  real X, maxScale;
+  real maxS[PATH_TILE_N];
+  real dMax[GREEK_N][PATH_TILE_N];
+  void begin(int i, real S0) {
+    maxS[i] = S0;
+    dMax[GREEK_DELTA][i] = 1;
+    dMax[GREEK_VEGA][i] = dMax[GREEK_RHO][i] = 0;
+  }
+  void step(int i, real, real S) { maxS[i] = S > maxS[i] ? S : maxS[i]; }
+  real end(int i, real) const {
+    const real M = maxS[i] * maxScale;
+    return M > X ? M - X : 0;
+  }
+  real control(int, real S) const { return S; }
+  void stepGreeks(int i, real, real S, const real *d) {
+    if (S > maxS[i])
+      for (int g = 0; g < GREEK_N; g++) dMax[g][i] = S * d[g];
+  }
+  void endGreeks(int i, real, real *greeks) const {
+    for (int g = 0; g < GREEK_N; g++)
+      greeks[g] = maxS[i] > X ? dMax[g][i] : 0;
+  }
+};
+
+struct GeometricAsianCallState {
+  real X, S0, invStepN;
+  real sumX[PATH_TILE_N];
+  real sumD[GREEK_N][PATH_TILE_N];
+  void begin(int i, real) {
+    sumX[i] = 0;
+    for (int g = 0; g < GREEK_N; g++) sumD[g][i] = 0;
+  }
+  void step(int i, real x, real) { sumX[i] += x; }
+  real end(int i, real) const {
+    const real G = S0 * std::exp(sumX[i] * invStepN);
+    return G > X ? G - X : 0;
+  }
+  real control(int, real S) const { return S; }
+  void stepGreeks(int i, real, real, const real *d) {
+    for (int g = 0; g < GREEK_N; g++) sumD[g][i] += d[g];
+  }
+  // d log G = mean of d log S(t_k)
+  void endGreeks(int i, real, real *greeks) const {
+    const real G = S0 * std::exp(sumX[i] * invStepN);
+    for (int g = 0; g < GREEK_N; g++)
+      greeks[g] = G > X ? G * sumD[g][i] * invStepN : 0;
+  }
+};
+
+struct AsianCallState {
+  GeometricAsianCallState geometric;
+  real sumS[PATH_TILE_N];
+  real sumDS[GREEK_N][PATH_TILE_N];
+  void begin(int i, real S0) {
+    sumS[i] = 0;
+    for (int g = 0; g < GREEK_N; g++) sumDS[g][i] = 0;
+    geometric.begin(i, S0);
+  }
+  void step(int i, real x, real S) {
+    sumS[i] += S;
+    geometric.step(i, x, S);
+  }
+  real end(int i, real) const {
+    const real A = sumS[i] * geometric.invStepN;
+    return A > geometric.X ? A - geometric.X : 0;
+  }
+  real control(int i, real S) const { return geometric.end(i, S); }
+  void stepGreeks(int i, real, real S, const real *d) {
+    for (int g = 0; g < GREEK_N; g++) sumDS[g][i] += S * d[g];
+  }
+  void endGreeks(int i, real, real *greeks) const {
+    const bool itm = sumS[i] * geometric.invStepN > geometric.X;
+    for (int g = 0; g < GREEK_N; g++)
+      greeks[g] = itm ? sumDS[g][i] * geometric.invStepN : 0;
+  }
+};
+
+// Barrier call with the barrier at log-return logH. Rather than sampling
+// whether the path crossed between two steps that both lie inside, each step
+// multiplies the path's survival weight by the Brownian-bridge probability
+// exp(-2 (logH - x0)(logH - x1) / (V^2 dt)) that it did not; the knock-in
+// payoff is the call times the probability of having been knocked. The
+// weight is continuous in the path, so it is differentiated pathwise too,
+// including the explicit dependence of the crossing probability on V.
+template <bool up, bool knockIn>
+struct BarrierCallState {
+  real X, logH, twoByVarDt, V;
+  real prevX[PATH_TILE_N];
+  real survival[PATH_TILE_N];
+  real prevD[GREEK_N][PATH_TILE_N];
+  real dSurvival[GREEK_N][PATH_TILE_N];
+  void begin(int i, real S0) {
+    prevX[i] = 0;
+    survival[i] = (up ? logH > 0 : logH < 0) ? 1 : 0;
+    prevD[GREEK_DELTA][i] = 1 / S0;
+    prevD[GREEK_VEGA][i] = prevD[GREEK_RHO][i] = 0;
+    for (int g = 0; g < GREEK_N; g++) dSurvival[g][i] = 0;
+  }
+  void step(int i, real x, real) {
+    const bool inside = up ? x < logH : x > logH;
+    const real crossing =
+        std::exp(-twoByVarDt * (logH - prevX[i]) * (logH - x));
+    survival[i] = inside ? survival[i] * (1 - crossing) : 0;
+    prevX[i] = x;
+  }
+  real end(int i, real S) const {
+    const real call = S > X ? S - X : 0;
+    return call * (knockIn ? 1 - survival[i] : survival[i]);
+  }
+  real control(int, real S) const { return S; }
+  void stepGreeks(int i, real x, real, const real *d) {
+    const bool inside = up ? x < logH : x > logH;
+    const real a = logH - prevX[i], b = logH - x;
+    const real logP = -twoByVarDt * a * b;
+    const real p = std::exp(logP);
+
+    for (int g = 0; g < GREEK_N; g++) {
+      real dLogP = twoByVarDt * (prevD[g][i] * b + a * d[g]);
+      if (g == GREEK_VEGA) dLogP -= 2 * logP / V;
+      dSurvival[g][i] =
+          inside ? dSurvival[g][i] * (1 - p) - survival[i] * p * dLogP : 0;
+      prevD[g][i] = d[g];
+    }
+  }
+  void endGreeks(int i, real S, real *greeks) const {
+    const real call = S > X ? S - X : 0;
+    const real w = knockIn ? 1 - survival[i] : survival[i];
+    for (int g = 0; g < GREEK_N; g++) {
+      const real dCall = S > X ? S * prevD[g][i] : 0;
+      const real dW = knockIn ? -dSurvival[g][i] : dSurvival[g][i];
+      greeks[g] = dCall * w + call * dW;
+    }
+  }
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Normals of one step (dimension) of the tile
+////////////////////////////////////////////////////////////////////////////////
+const float *tileNormals(float *buffer, const TBatchPlan &batch, int option,
+                         uint64_t sampleFirst, int tileN, uint32_t stream) {
+  const uint64_t philoxFirst = sampleFirst >> 2;
+  const int philoxN = (int)(((sampleFirst + tileN + 3) >> 2) - philoxFirst);
+  normalGenerator(buffer, philoxFirst, philoxN, philoxKey(batch.seed), option,
+                  stream);
+  return buffer + (sampleFirst & 3);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Quasi-random increments of the whole tile: dimension d of the Sobol point
+// feeds the d-th bridge normal; the bridge values are differenced back into
+// unit-variance step normals z[k * tileN + i]
+////////////////////////////////////////////////////////////////////////////////
+static void bridgeNormals(float *z, const TBatchPlan &batch, int option,
+                          uint64_t sampleFirst, int tileN) {
+  const int M = batch.stepN;
+  const int replica = (int)(sampleFirst / batch.replicaPathN);
+  const uint32_t point = (uint32_t)(sampleFirst % batch.replicaPathN);
+  const real sqrtM = (real)sqrt((double)M);
+  thread_local std::vector<float> dims;
+  thread_local std::vector<real> W;
+  dims.resize(M);
+  W.resize(M);
+
+  for (int d = 0; d < M; d++)
+    sobolNormals(z + d * tileN, tileN, philoxKey(batch.seed), option, replica,
+                 d, point);
+
+  for (int i = 0; i < tileN; i++) {
+    for (int d = 0; d < M; d++) dims[d] = z[d * tileN + i];
+    buildBrownianPath(batch.bridge, dims.data(), W.data());
+    for (int k = 0; k < M; k++)
+      z[k * tileN + i] = (float)((W[k] - (k ? W[k - 1] : 0)) * sqrtM);
+  }
+}
+
+template <class State>
+static void evolveTile(State &state, const TBatchPlan &batch, int option,
+                       uint64_t sampleFirst, int tileN, real sign,
+                       real *payoff, real *control, real *greeks) {
+  const TOptionBatch &options = *batch.options;
+  const int M = batch.stepN;
+  const real S0 = options.S[option];
+  const real MuByDt = (real)((double)options.MuByT[option] / M);
+  const real VBySqrtDt = (real)((double)options.VBySqrtT[option] / sqrt(M));
+  const real sqrtDt = (real)sqrt((double)options.T[option] / M);
+  const real V = options.V[option];
+  const bool qmc = batch.qmcReplicaN > 0;
+
+  alignas(64) float buffer[PATH_TILE_N + 8];
+  thread_local std::vector<float> bridged;
+  real x[PATH_TILE_N], S[PATH_TILE_N], W[PATH_TILE_N];
+
+  if (qmc) {
+    bridged.resize((size_t)M * tileN);
+    bridgeNormals(bridged.data(), batch, option, sampleFirst, tileN);
+  }
+
+  for (int i = 0; i < tileN; i++) {
+    x[i] = 0;
+    W[i] = 0;
+    state.begin(i, S0);
+  }
+
+  for (int k = 0; k < M; k++) {
+    const float *z =
+        qmc ? bridged.data() + (size_t)k * tileN
+            : tileNormals(buffer, batch, option, sampleFirst, tileN, k);
+
+    if (greeks) {
+      const real t = (real)((double)options.T[option] * (k + 1) / M);
+      real d[GREEK_N] = {1 / S0, 0, t};
+
+      for (int i = 0; i < tileN; i++) {
+        x[i] += MuByDt + VBySqrtDt * (sign * (real)z[i]);
+        S[i] = S0 * std::exp(x[i]);
+        W[i] += sqrtDt * (sign * (real)z[i]);
+        d[GREEK_VEGA] = W[i] - V * t;
+        state.stepGreeks(i, x[i], S[i], d);
+        state.step(i, x[i], S[i]);
+      }
+    } else {
+      for (int i = 0; i < tileN; i++) {
+        x[i] += MuByDt + VBySqrtDt * (sign * (real)z[i]);
+        S[i] = S0 * std::exp(x[i]);
+        state.step(i, x[i], S[i]);
+      }
+    }
+  }
+
+  for (int i = 0; i < tileN; i++) {
+    payoff[i] = state.end(i, S[i]);
+    control[i] = state.control(i, S[i]);
+  }
+
+  if (greeks) {
+    for (int i = 0; i < tileN; i++) {
+      real g[GREEK_N];
+      state.endGreeks(i, S[i], g);
+      for (int j = 0; j < GREEK_N; j++) greeks[j * PATH_TILE_N + i] = g[j];
+    }
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Paths of the models other than GBM: a model stepper advances the tile's
+// log-returns x one step at a time, drawing its normals from the step's
+// streams, and the payoff state watches the prices as for GBM. Pseudo-random
+// samples only, without Greeks.
+////////////////////////////////////////////////////////////////////////////////
+
+// Heston (MonteCarlo_heston.h): variances advance alongside the log-returns
+struct HestonPaths {
+  THestonStep step;
+  real v[PATH_TILE_N];
+  alignas(64) float bufferV[PATH_TILE_N + 8];
+
+  HestonPaths(const TBatchPlan &batch, int option, int tileN) {
+    const TOptionBatch &options = *batch.options;
+    const real V = options.V[option];
+    initHestonStep(&step, options.heston[option], options.R[option],
+                   (double)options.T[option] / batch.stepN);
+    for (int i = 0; i < tileN; i++) v[i] = V * V;
+  }
+  void advance(const TBatchPlan &batch, int option, uint64_t sampleFirst,
+               int tileN, int k, const float *z, real sign, real *x) {
+    const float *zV = tileNormals(bufferV, batch, option, sampleFirst, tileN,
+                                  FACTOR_STREAM + k);
+    hestonStep(step, x, v, z, zV, sign, tileN);
+  }
+};
+
+// Local volatility (MonteCarlo_localvol.h): each step first slices the
+// option's surface at the step's start time
+struct LocalVolPaths {
+  const TLocalVol &surface;
+  double dt;
+  real RDt, xShift;
+  alignas(64) TLocalVolSlice slice;
+
+  LocalVolPaths(const TBatchPlan &batch, int option, int)
+      : surface(batch.options->surfaces[batch.options->Surface[option]]) {
+    const TOptionBatch &options = *batch.options;
+    dt = (double)options.T[option] / batch.stepN;
+    RDt = (real)(options.R[option] * dt);
+    xShift = (real)log((double)options.S[option] / surface.spot);
+  }
+  void advance(const TBatchPlan &, int, uint64_t, int tileN, int k,
+               const float *z, real sign, real *x) {
+    localVolSlice(&slice, surface, k * dt);
+    localVolStep(slice, x, z, sign, xShift, RDt, (real)dt, tileN);
+  }
+};
+
+// Merton jump-diffusion (MonteCarlo_merton.h): jump counts and sizes come
+// from two more normals per step
+struct MertonPaths {
+  TMertonStep step;
+  alignas(64) float bufferCount[PATH_TILE_N + 8];
+  alignas(64) float bufferJump[PATH_TILE_N + 8];
+
+  MertonPaths(const TBatchPlan &batch, int option, int) {
+    const TOptionBatch &options = *batch.options;
+    initMertonStep(&step, options.merton[option], options.R[option],
+                   options.V[option],
+                   (double)options.T[option] / batch.stepN);
+  }
+  void advance(const TBatchPlan &batch, int option, uint64_t sampleFirst,
+               int tileN, int k, const float *z, real sign, real *x) {
+    const float *zCount = tileNormals(bufferCount, batch, option, sampleFirst,
+                                      tileN, FACTOR_STREAM + k);
+    const float *zJump = tileNormals(bufferJump, batch, option, sampleFirst,
+                                     tileN, 2 * FACTOR_STREAM + k);
+    mertonStep(step, x, z, zCount, zJump, sign, tileN);
+  }
+};
+
+template <class Model, class State>
+static void evolveModelTile(State &state, const TBatchPlan &batch, int option,
+                            uint64_t sampleFirst, int tileN, real sign,
+                            real *payoff, real *control) {
+  const real S0 = batch.options->S[option];
+  Model model(batch, option, tileN);
+
+  alignas(64) float buffer[PATH_TILE_N + 8];
+  real x[PATH_TILE_N], S[PATH_TILE_N];
+
+  for (int i = 0; i < tileN; i++) {
+    x[i] = 0;
+    S[i] = S0;
+    state.begin(i, S0);
+  }
+
+  for (int k = 0; k < batch.stepN; k++) {
+    const float *z = tileNormals(buffer, batch, option, sampleFirst, tileN, k);
+
+    model.advance(batch, option, sampleFirst, tileN, k, z, sign, x);
+    for (int i = 0; i < tileN; i++) {
+      S[i] = S0 * std::exp(x[i]);
+      state.step(i, x[i], S[i]);
+    }
+  }
+
+  for (int i = 0; i < tileN; i++) {
+    payoff[i] = state.end(i, S[i]);
+    control[i] = state.control(i, S[i]);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Payoff parameters of an option monitored on a grid of stepN steps. With
+// continuous set, the payoff approximates its continuously monitored limit.
+////////////////////////////////////////////////////////////////////////////////
+static void initState(CallState &state, const TOptionBatch &options,
+                      int option, int, bool) {
+  state.X = options.X[option];
+}
+
+static void initState(DigitalCallState &state, const TOptionBatch &options,
+                      int option, int, bool) {
+  state.X = options.X[option];
+  state.S0 = options.S[option];
+  state.V = options.V[option];
+  state.T = options.T[option];
+}
+
+static void initState(LookbackCallState &state, const TOptionBatch &options,
+                      int option, int stepN, bool continuous) {
+  const double dt = (double)options.T[option] / stepN;
+
+  state.X = options.X[option];
+  state.maxScale =
+      continuous ? (real)exp(0.5826 * options.V[option] * sqrt(dt)) : 1;
+}
+
+static void initState(GeometricAsianCallState &state,
+                      const TOptionBatch &options, int option, int stepN,
+                      bool) {
+  state.X = options.X[option];
+  state.S0 = options.S[option];
+  state.invStepN = (real)(1.0 / stepN);
+}
+
+static void initState(AsianCallState &state, const TOptionBatch &options,
+                      int option, int stepN, bool continuous) {
+  initState(state.geometric, options, option, stepN, continuous);
+}
+
+template <bool up, bool knockIn>
+static void initState(BarrierCallState<up, knockIn> &state,
+                      const TOptionBatch &options, int option, int stepN,
+                      bool) {
+  const double V = options.V[option];
+
+  state.V = options.V[option];
+  state.X = options.X[option];
+  state.logH = (real)log((double)options.Barrier[option] / options.S[option]);
+  state.twoByVarDt =
+      (real)(2.0 * stepN / (V * V * (double)options.T[option]));
+}
+
+template <class State>
+static void simulateTile(const TBatchPlan &batch, int option,
+                         uint64_t sampleFirst, int tileN, real sign,
+                         real *payoff, real *control, real *greeks) {
+  State state;
+  initState(state, *batch.options, option, batch.stepN, false);
+  switch (batch.options->Model[option]) {
+    case MODEL_HESTON:
+      evolveModelTile<HestonPaths>(state, batch, option, sampleFirst, tileN,
+                                   sign, payoff, control);
+      break;
+    case MODEL_LOCAL_VOL:
+      evolveModelTile<LocalVolPaths>(state, batch, option, sampleFirst, tileN,
+                                     sign, payoff, control);
+      break;
+    case MODEL_MERTON:
+      evolveModelTile<MertonPaths>(state, batch, option, sampleFirst, tileN,
+                                   sign, payoff, control);
+      break;
+    default:
+      evolveTile(state, batch, option, sampleFirst, tileN, sign, payoff,
+                 control, greeks);
+      break;
+  }
+}
+
+void simulatePathTile(const TBatchPlan &batch, int option,
+                      uint64_t sampleFirst, int tileN, real sign,
+                      real *payoff, real *control, real *greeks) {
+  switch (batch.options->Payoff[option]) {
+    case PAYOFF_LOOKBACK_CALL:
+      simulateTile<LookbackCallState>(batch, option, sampleFirst, tileN, sign,
+                                      payoff, control, greeks);
+      break;
+    case PAYOFF_ASIAN_CALL:
+      simulateTile<AsianCallState>(batch, option, sampleFirst, tileN, sign,
+                                   payoff, control, greeks);
+      break;
+    case PAYOFF_GEOMETRIC_ASIAN_CALL:
+      simulateTile<GeometricAsianCallState>(batch, option, sampleFirst, tileN,
+                                            sign, payoff, control, greeks);
+      break;
+    case PAYOFF_DOWN_OUT_CALL:
+      simulateTile<BarrierCallState<false, false>>(
+          batch, option, sampleFirst, tileN, sign, payoff, control, greeks);
+      break;
+    case PAYOFF_DOWN_IN_CALL:
+      simulateTile<BarrierCallState<false, true>>(
+          batch, option, sampleFirst, tileN, sign, payoff, control, greeks);
+      break;
+    case PAYOFF_UP_OUT_CALL:
+      simulateTile<BarrierCallState<true, false>>(
+          batch, option, sampleFirst, tileN, sign, payoff, control, greeks);
+      break;
+    case PAYOFF_UP_IN_CALL:
+      simulateTile<BarrierCallState<true, true>>(
+          batch, option, sampleFirst, tileN, sign, payoff, control, greeks);
+      break;
+    case PAYOFF_BASKET_CALL:
+      simulateBasketTile(batch, option, sampleFirst, tileN, sign, payoff,
+                         control, NULL);
+      break;
+    case PAYOFF_DIGITAL_CALL:
+      simulateTile<DigitalCallState>(batch, option, sampleFirst, tileN, sign,
+                                     payoff, control, greeks);
+      break;
+    default:
+      simulateTile<CallState>(batch, option, sampleFirst, tileN, sign, payoff,
+                              control, greeks);
+      break;
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Coupled fine and coarse paths of one multilevel level. With exact
+// log-price steps the coarse path's prices are the fine path's prices at
+// every other date, so the coarse payoff state simply watches the fine
+// path there; only the monitoring differs between the two.
+////////////////////////////////////////////////////////////////////////////////
+template <class State>
+static void evolveLevelTile(const TBatchPlan &batch, int option, int level,
+                            uint64_t sampleFirst, int tileN, real *fine,
+                            real *coarse) {
+  const TOptionBatch &options = *batch.options;
+  const int M = levelStepN(batch, level);
+  const real S0 = options.S[option];
+  const real MuByDt = (real)((double)options.MuByT[option] / M);
+  const real VBySqrtDt = (real)((double)options.VBySqrtT[option] / sqrt(M));
+
+  alignas(64) float buffer[PATH_TILE_N + 8];
+  real x[PATH_TILE_N], S[PATH_TILE_N];
+  State fineState, coarseState;
+
+  // Level 0 has no coarse path; its coarse state runs on the fine grid and
+  // is never stepped or read
+  initState(fineState, options, option, M, true);
+  initState(coarseState, options, option, level > 0 ? M / 2 : M, true);
+
+  for (int i = 0; i < tileN; i++) {
+    x[i] = 0;
+    fineState.begin(i, S0);
+    coarseState.begin(i, S0);
+  }
+
+  for (int k = 0; k < M; k++) {
+    const float *z = tileNormals(buffer, batch, option, sampleFirst, tileN,
+                                 levelStream(level, k));
+
+    for (int i = 0; i < tileN; i++) {
+      x[i] += MuByDt + VBySqrtDt * (real)z[i];
+      S[i] = S0 * std::exp(x[i]);
+      fineState.step(i, x[i], S[i]);
+    }
+
+    if (level > 0 && (k & 1))
+      for (int i = 0; i < tileN; i++) coarseState.step(i, x[i], S[i]);
+  }
+
+  for (int i = 0; i < tileN; i++) {
+    fine[i] = fineState.end(i, S[i]);
+    coarse[i] = level > 0 ? coarseState.end(i, S[i]) : 0;
+  }
+}
+
+void simulateLevelTile(const TBatchPlan &batch, int option, int level,
+                       uint64_t sampleFirst, int tileN, real *fine,
+                       real *coarse) {
+  switch (batch.options->Payoff[option]) {
+    case PAYOFF_LOOKBACK_CALL:
+      evolveLevelTile<LookbackCallState>(batch, option, level, sampleFirst,
+                                         tileN, fine, coarse);
+      break;
+    case PAYOFF_ASIAN_CALL:
+      evolveLevelTile<AsianCallState>(batch, option, level, sampleFirst, tileN,
+                                      fine, coarse);
+      break;
+    case PAYOFF_GEOMETRIC_ASIAN_CALL:
+      evolveLevelTile<GeometricAsianCallState>(batch, option, level,
+                                               sampleFirst, tileN, fine,
+                                               coarse);
+      break;
+    case PAYOFF_DOWN_OUT_CALL:
+      evolveLevelTile<BarrierCallState<false, false>>(
+          batch, option, level, sampleFirst, tileN, fine, coarse);
+      break;
+    case PAYOFF_DOWN_IN_CALL:
+      evolveLevelTile<BarrierCallState<false, true>>(
+          batch, option, level, sampleFirst, tileN, fine, coarse);
+      break;
+    case PAYOFF_UP_OUT_CALL:
+      evolveLevelTile<BarrierCallState<true, false>>(
+          batch, option, level, sampleFirst, tileN, fine, coarse);
+      break;
+    case PAYOFF_UP_IN_CALL:
+      evolveLevelTile<BarrierCallState<true, true>>(
+          batch, option, level, sampleFirst, tileN, fine, coarse);
+      break;
+    case PAYOFF_DIGITAL_CALL:
+      evolveLevelTile<DigitalCallState>(batch, option, level, sampleFirst,
+                                        tileN, fine, coarse);
+      break;
+    default:
+      evolveLevelTile<CallState>(batch, option, level, sampleFirst, tileN,
+                                 fine, coarse);
+      break;
+  }
+}
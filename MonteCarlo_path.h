@@ -0,0 +1,53 @@
+#ifndef MONTECARLO_PATH_H
+#define MONTECARLO_PATH_H
+
+#include <cstdint>
+
+#include "MonteCarlo_common.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Multi-step GBM path engine. Paths are evolved a tile at a time, step by
+// step, keeping only the current state of each path (log-price, price and
+// the running statistics its payoff needs) in tile-sized arrays; full
+// paths x steps matrices are never materialised. Heston options evolve
+// their variance alongside (MonteCarlo_heston.h), local volatility options
+// look their volatility up on a surface (MonteCarlo_localvol.h) and Merton
+// options add jumps (MonteCarlo_merton.h).
+//
+// With pseudo-random samples the normals of step k come from Philox stream
+// k, so a one-step path reproduces the European fast path exactly. With
+// quasi-random samples the tile's stepN Sobol dimensions are turned into
+// increments by the Brownian bridge first, which needs stepN x tile floats.
+////////////////////////////////////////////////////////////////////////////////
+const int PATH_TILE_N = 256;
+
+// Models with more than one normal per step draw the f-th extra normal of
+// step k (f >= 1) from Philox stream f * FACTOR_STREAM + k
+const uint32_t FACTOR_STREAM = 1u << 30;
+
+// Pseudo-random normals of samples [sampleFirst, sampleFirst + tileN) of
+// Philox stream (option, stream). buffer needs room for tileN + 8 floats;
+// returns a pointer to the first sample inside it.
+const float *tileNormals(float *buffer, const TBatchPlan &batch, int option,
+                         uint64_t sampleFirst, int tileN, uint32_t stream);
+
+// Simulate tileN paths of one option whose samples start at sampleFirst.
+// sign = -1 runs the antithetic reflection of the same samples. Writes the
+// undiscounted payoff and the raw control variate sample of each path (see
+// TBatchPlan::controlVariate). Unless greeks is NULL, greeks[g * PATH_TILE_N
+// + i] receives the derivative of path i's undiscounted payoff with respect
+// to the spot, volatility and rate (GREEK_DELTA, GREEK_VEGA, GREEK_RHO).
+void simulatePathTile(const TBatchPlan &batch, int option,
+                      uint64_t sampleFirst, int tileN, real sign,
+                      real *payoff, real *control, real *greeks);
+
+// Simulate tileN coupled paths of one level of a multilevel option
+// (MonteCarlo_mlmc.h), writing the undiscounted payoff of each path on the
+// level's fine grid and on its coarse grid of every other date (0 on level
+// 0). The fine normals of step k come from Philox stream levelStream(level,
+// k).
+void simulateLevelTile(const TBatchPlan &batch, int option, int level,
+                       uint64_t sampleFirst, int tileN, real *fine,
+                       real *coarse);
+
+#endif
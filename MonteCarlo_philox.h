@@ -0,0 +1,66 @@
+#ifndef MONTECARLO_PHILOX_H
+#define MONTECARLO_PHILOX_H
+
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////////////
+// Counter-based Philox4x32-10 generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3"). Each (key, counter) pair maps to four
+// independent 32-bit outputs, so any position of any stream is reached in
+// O(1) by setting the counter; there is no state to set up or carry.
+//
+// Streams used by the pricer:
+//   key     = batch seed
+//   counter = (path index / 4, option index, stream id)
+// and lane (path index % 4) of the output block belongs to that path.
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  uint32_t v[4];
+} TPhiloxCounter;
+
+typedef struct {
+  uint32_t v[2];
+} TPhiloxKey;
+
+static inline void philoxMulHiLo(uint32_t a, uint32_t b, uint32_t &hi,
+                                 uint32_t &lo) {
+  uint64_t product = (uint64_t)a * (uint64_t)b;
+  hi = (uint32_t)(product >> 32);
+  lo = (uint32_t)product;
+}
+
+static inline TPhiloxCounter philox4x32_10(TPhiloxCounter c, TPhiloxKey k) {
+  const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+  const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+  for (int round = 0; round < 10; round++) {
+    uint32_t hi0, lo0, hi1, lo1;
+    philoxMulHiLo(M0, c.v[0], hi0, lo0);
+    philoxMulHiLo(M1, c.v[2], hi1, lo1);
+
+    TPhiloxCounter next = {{hi1 ^ c.v[1] ^ k.v[0], lo1,
+                            hi0 ^ c.v[3] ^ k.v[1], lo0}};
+    c = next;
+    k.v[0] += W0;
+    k.v[1] += W1;
+  }
+
+  return c;
+}
+
+static inline TPhiloxKey philoxKey(uint64_t seed) {
+  TPhiloxKey key = {{(uint32_t)seed, (uint32_t)(seed >> 32)}};
+  return key;
+}
+
+// Counter of the output block holding sample `index` of stream
+// (option, stream)
+static inline TPhiloxCounter philoxCounter(uint64_t index, uint32_t option,
+                                           uint32_t stream) {
+  uint64_t block = index >> 2;
+  TPhiloxCounter c = {{(uint32_t)block, (uint32_t)(block >> 32), option,
+                       stream}};
+  return c;
+}
+
+#endif
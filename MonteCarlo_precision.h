@@ -0,0 +1,38 @@
+#ifndef MONTECARLO_PRECISION_H
+#define MONTECARLO_PRECISION_H
+
+#include "MonteCarlo_reduction.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Precision policies of the one-step European kernel. Path is the type of the
+// per-path arithmetic (terminal price, payoff and Greeks), Accum the type of
+// the interleaved lane sums of a path block. A batch picks its policy at run
+// time (TBatchPlan::precision), so one binary runs all of them; realtype.h
+// still sets the storage type of option data and the arithmetic of the
+// path-dependent engines. Normals are float samples under every policy, so
+// policies differ in rounding only, never in the samples they price.
+////////////////////////////////////////////////////////////////////////////////
+template <class PathType, class AccumType>
+struct TPrecisionPolicy {
+  typedef PathType Path;
+  typedef AccumType Accum;
+};
+
+typedef TPrecisionPolicy<float, float> PrecisionFloat;
+typedef TPrecisionPolicy<float, TCompensated<float> > PrecisionCompensated;
+typedef TPrecisionPolicy<float, double> PrecisionMixed;
+typedef TPrecisionPolicy<double, double> PrecisionDouble;
+
+typedef enum {
+  // Float paths and float lane sums
+  PRECISION_FLOAT = 0,
+  // Float paths and float lanes with compensated (Kahan-Babuska) sums
+  PRECISION_COMPENSATED,
+  // Float paths summed in double lanes
+  PRECISION_MIXED,
+  // Double paths and lanes
+  PRECISION_DOUBLE,
+  PRECISION_N
+} TPrecision;
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef MONTECARLO_REDUCTION_H
+#define MONTECARLO_REDUCTION_H
+
+////////////////////////////////////////////////////////////////////////////////
+// Fixed-shape reductions. The order in which partial sums are combined depends
+// only on their count, never on how the work was split between devices or
+// threads, so sums are bitwise reproducible for any device count.
+////////////////////////////////////////////////////////////////////////////////
+
+// Interleaved accumulators per path block: path k of a block goes to lane
+// k % REDUCTION_LANES, and the lanes are then combined by treeSum()
+const int REDUCTION_LANES = 16;
+
+// Pairwise sum of a[0 .. n): split at the largest power of two below n and
+// recurse, giving O(log n) error growth and a shape fixed by n alone
+template <class T>
+static inline T treeSum(const T *a, int n) {
+  if (n <= 0) return T();
+  if (n == 1) return a[0];
+
+  int half = 1;
+  while (half * 2 < n) half *= 2;
+
+  return treeSum(a, half) + treeSum(a + half, n - half);
+}
+
+// Compensated (Kahan-Babuska) accumulator: error collects the exact rounding
+// error of every addition to sum, found by the branch-free TwoSum, so a float
+// accumulator keeps nearly double-precision digits. Converting to double adds
+// the two parts back together.
+template <class T>
+struct TCompensated {
+  T sum;
+  T error;
+
+  TCompensated(T value = 0) : sum(value), error(0) {}
+
+  TCompensated &operator+=(T x) {
+    const T t = sum + x;
+    const T z = t - sum;
+    error += (sum - (t - z)) + (x - z);
+    sum = t;
+    return *this;
+  }
+
+  TCompensated operator+(const TCompensated &b) const {
+    TCompensated c(sum);
+    c += b.sum;
+    c.error += error + b.error;
+    return c;
+  }
+
+  operator double() const { return (double)sum + (double)error; }
+};
+
+#endif
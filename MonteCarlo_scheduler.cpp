@@ -0,0 +1,44 @@
+////////////////////////////////////////////////////////////////////////////////
+// Work-stealing scheduler over per-device deques
+////////////////////////////////////////////////////////////////////////////////
+#include "MonteCarlo_scheduler.h"
+
+TaskScheduler::TaskScheduler(int deviceN, bool steal) : steal(steal) {
+  for (int i = 0; i < deviceN; i++) queues.emplace_back(new Queue);
+}
+
+void TaskScheduler::push(int device, const TTask &task) {
+  Queue &q = *queues[device];
+  std::lock_guard<std::mutex> guard(q.lock);
+  q.tasks.push_back(task);
+}
+
+bool TaskScheduler::pop(int device, TTask &task, bool &stolen) {
+  const int deviceN = (int)queues.size();
+
+  {
+    Queue &q = *queues[device];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (!q.tasks.empty()) {
+      task = q.tasks.front();
+      q.tasks.pop_front();
+      stolen = false;
+      return true;
+    }
+  }
+
+  if (!steal) return false;
+
+  for (int k = 1; k < deviceN; k++) {
+    Queue &q = *queues[(device + k) % deviceN];
+    std::lock_guard<std::mutex> guard(q.lock);
+    if (!q.tasks.empty()) {
+      task = q.tasks.back();
+      q.tasks.pop_back();
+      stolen = true;
+      return true;
+    }
+  }
+
+  return false;
+}
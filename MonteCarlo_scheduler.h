@@ -0,0 +1,45 @@
+#ifndef MONTECARLO_SCHEDULER_H
+#define MONTECARLO_SCHEDULER_H
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+// Unit of scheduled work: one path chunk of one option (or option level)
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  // Global option index
+  int option;
+  // Path chunk index within the option; for multilevel tasks, the first path
+  // block within the level
+  int chunk;
+  // Multilevel level
+  int level;
+} TTask;
+
+////////////////////////////////////////////////////////////////////////////////
+// Per-device task deques. A device pops from the front of its own deque and,
+// once that is empty, steals from the back of its neighbours' deques in ring
+// order. With stealing disabled every device only runs its own slice.
+////////////////////////////////////////////////////////////////////////////////
+class TaskScheduler {
+ public:
+  TaskScheduler(int deviceN, bool steal);
+
+  void push(int device, const TTask &task);
+  // Returns false once no task is left for this device
+  bool pop(int device, TTask &task, bool &stolen);
+
+ private:
+  struct Queue {
+    std::mutex lock;
+    std::deque<TTask> tasks;
+  };
+
+  std::vector<std::unique_ptr<Queue>> queues;
+  bool steal;
+};
+
+#endif
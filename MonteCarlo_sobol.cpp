@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////
+// Sobol sequence: direction numbers and Gray-code point generation
+////////////////////////////////////////////////////////////////////////////////
+#include "MonteCarlo_sobol.h"
+#include "MonteCarlo_normal.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Joe-Kuo parameters for dimensions 2 .. SOBOL_MAX_DIM: degree s and
+// coefficients a of the primitive polynomial, initial direction numbers m
+////////////////////////////////////////////////////////////////////////////////
+typedef struct {
+  int s;
+  int a;
+  uint32_t m[8];
+} TSobolParams;
+
+static const TSobolParams sobolParams[SOBOL_MAX_DIM - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1, {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}},
+    {6, 19, {1, 1, 1, 15, 7, 5}},
+    {6, 22, {1, 3, 1, 15, 13, 25}},
+    {6, 25, {1, 1, 5, 5, 19, 61}},
+    {7, 1, {1, 3, 7, 11, 23, 15, 103}},
+    {7, 4, {1, 3, 7, 13, 13, 15, 69}},
+    {7, 7, {1, 1, 3, 13, 7, 35, 63}},
+    {7, 8, {1, 3, 5, 9, 1, 25, 53}},
+    {7, 14, {1, 3, 1, 13, 9, 35, 107}},
+    {7, 19, {1, 3, 1, 5, 27, 61, 31}},
+    {7, 21, {1, 1, 5, 11, 19, 41, 61}},
+    {7, 28, {1, 3, 5, 3, 3, 13, 69}},
+    {7, 31, {1, 1, 7, 13, 1, 19, 1}},
+    {7, 32, {1, 3, 7, 5, 13, 19, 59}},
+    {7, 37, {1, 1, 3, 9, 25, 29, 41}},
+    {7, 41, {1, 3, 5, 13, 23, 1, 55}},
+    {7, 42, {1, 3, 7, 3, 13, 59, 17}},
+    {7, 50, {1, 3, 1, 3, 5, 53, 69}},
+    {7, 55, {1, 1, 5, 5, 23, 33, 13}},
+    {7, 56, {1, 1, 7, 7, 1, 61, 123}},
+    {7, 59, {1, 1, 7, 9, 13, 61, 49}},
+    {7, 62, {1, 3, 3, 5, 3, 55, 33}},
+};
+
+static void initSobolDirections(TSobolDirections &dir) {
+  // First dimension: van der Corput sequence in base 2
+  for (int k = 0; k < SOBOL_BITS; k++) dir.v[0][k] = 1u << (31 - k);
+
+  for (int d = 1; d < SOBOL_MAX_DIM; d++) {
+    const TSobolParams &p = sobolParams[d - 1];
+    uint32_t *v = dir.v[d];
+
+    for (int k = 0; k < p.s && k < SOBOL_BITS; k++)
+      v[k] = p.m[k] << (31 - k);
+
+    for (int k = p.s; k < SOBOL_BITS; k++) {
+      v[k] = v[k - p.s] ^ (v[k - p.s] >> p.s);
+      for (int j = 1; j < p.s; j++)
+        if ((p.a >> (p.s - 1 - j)) & 1) v[k] ^= v[k - j];
+    }
+  }
+}
+
+const TSobolDirections &getSobolDirections() {
+  static TSobolDirections dir;
+  static bool init = (initSobolDirections(dir), true);
+  (void)init;
+  return dir;
+}
+
+uint32_t sobolPoint(const TSobolDirections &dir, int dim, uint32_t index) {
+  uint32_t gray = index ^ (index >> 1);
+  uint32_t x = 0;
+
+  for (int k = 0; gray; k++, gray >>= 1)
+    if (gray & 1) x ^= dir.v[dim][k];
+
+  return x;
+}
+
+void sobolPoints(uint32_t *x, const TSobolDirections &dir, int dim,
+                 uint32_t first, int n, uint32_t shift) {
+  if (n <= 0) return;
+
+  uint32_t point = sobolPoint(dir, dim, first);
+  x[0] = point ^ shift;
+
+  for (int i = 1; i < n; i++) {
+    // Gray code of index + 1 differs from that of index in the bit of the
+    // lowest zero of index
+    point ^= dir.v[dim][__builtin_ctz(~(first + i - 1))];
+    x[i] = point ^ shift;
+  }
+}
+
+void sobolNormals(float *z, int n, TPhiloxKey key, int option, int replica,
+                  int dim, uint32_t pointFirst) {
+  if (dim >= SOBOL_MAX_DIM) {
+    float buffer[4];
+    const uint32_t stream = ((uint32_t)replica << 16) | (uint32_t)dim;
+
+    for (int i = 0; i < n; i++) {
+      const uint32_t point = pointFirst + i;
+      if (i == 0 || (point & 3) == 0)
+        normalsScalar(buffer, point >> 2, 1, key, option, stream);
+      z[i] = buffer[point & 3];
+    }
+    return;
+  }
+
+  uint32_t bits[1024];
+  TPhiloxCounter c = {{(uint32_t)replica, (uint32_t)dim, (uint32_t)option,
+                       SOBOL_SHIFT_STREAM}};
+  const uint32_t shift = philox4x32_10(c, key).v[0];
+
+  for (int first = 0; first < n; first += 1024) {
+    const int count = n - first < 1024 ? n - first : 1024;
+    sobolPoints(bits, getSobolDirections(), dim, pointFirst + first, count,
+                shift);
+    for (int i = 0; i < count; i++)
+      z[first + i] = (float)inverseNormalCDF(sobolUniform(bits[i]));
+  }
+}
@@ -0,0 +1,49 @@
+#ifndef MONTECARLO_SOBOL_H
+#define MONTECARLO_SOBOL_H
+
+#include <cstdint>
+
+#include "MonteCarlo_philox.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Sobol low-discrepancy sequence with Joe-Kuo direction numbers
+// (new-joe-kuo-6.21201, first SOBOL_MAX_DIM dimensions), 32-bit resolution.
+// Points are generated in Gray-code order, so point n of any dimension is
+// reached directly from n in O(bits) and consecutive points then cost one XOR
+// each; devices can therefore take disjoint index ranges without a setup pass.
+////////////////////////////////////////////////////////////////////////////////
+const int SOBOL_BITS = 32;
+const int SOBOL_MAX_DIM = 37;
+
+typedef struct {
+  uint32_t v[SOBOL_MAX_DIM][SOBOL_BITS];
+} TSobolDirections;
+
+// Direction numbers shared by every generator; built on first use
+const TSobolDirections &getSobolDirections();
+
+// Coordinate `dim` of point `index`
+uint32_t sobolPoint(const TSobolDirections &dir, int dim, uint32_t index);
+
+// Coordinates `dim` of points first .. first + n - 1, each XORed with a
+// random digital shift
+void sobolPoints(uint32_t *x, const TSobolDirections &dir, int dim,
+                 uint32_t first, int n, uint32_t shift);
+
+// Map a shifted coordinate to the midpoint of its cell in (0, 1)
+static inline double sobolUniform(uint32_t x) {
+  return ((double)x + 0.5) * (1.0 / 4294967296.0);
+}
+
+// Philox stream id of the digital shifts
+const uint32_t SOBOL_SHIFT_STREAM = 0x50B0;
+
+// N(0,1) samples of dimension `dim` for points pointFirst .. pointFirst + n - 1
+// of one randomised replica of an option. The digital shift is drawn from
+// Philox keyed by the batch seed and addressed by (replica, dim, option).
+// Dimensions beyond SOBOL_MAX_DIM fall back to Philox normals of stream
+// (replica << 16 | dim), which keeps replicas independent.
+void sobolNormals(float *z, int n, TPhiloxKey key, int option, int replica,
+                  int dim, uint32_t pointFirst);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef REALTYPE_H
+#define REALTYPE_H
+
+// Storage type of option data and results, and the arithmetic of the
+// path-dependent engines. Define DOUBLE_PRECISION (or configure with
+// -DDOUBLE_PRECISION=ON) to switch it for the whole build. One-step European
+// calls choose their arithmetic per batch instead (MonteCarlo_precision.h);
+// this type only sets their default.
+#ifdef DOUBLE_PRECISION
+typedef double real;
+#else
+typedef float real;
+#endif
+
+#endif